@@ -0,0 +1,159 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "alloc_report.h"
+#include "helpers.h"
+
+void AllocationReport::begin_file(const std::string &filename) {
+    files.emplace_back();
+    files.back().filename = filename;
+}
+
+AllocationReport::FileAllocations &AllocationReport::current_file() {
+    return files.back();
+}
+
+void AllocationReport::begin_phase(Phase) {
+    phase_start = thread_allocations();
+}
+
+void AllocationReport::end_phase(Phase phase) {
+    const AllocationCounts end = thread_allocations();
+    const size_t allocations = end.allocations - phase_start.allocations;
+    const size_t bytes = end.bytes - phase_start.bytes;
+
+    FileAllocations &file = current_file();
+    AllocationCounts &counts = file.phases[static_cast<size_t>(phase)];
+    counts.allocations += allocations;
+    counts.bytes += bytes;
+    file.total.allocations += allocations;
+    file.total.bytes += bytes;
+}
+
+static std::string format_row(const std::string &name, size_t name_width, size_t spans,
+    const AllocationCounts &counts, size_t total_bytes) {
+    const double percent = total_bytes > 0 ? 100.0 * counts.bytes / total_bytes : 0;
+    const double allocations_per_span = spans > 0 ? 1.0 * counts.allocations / spans : 0;
+    const double bytes_per_span = spans > 0 ? 1.0 * counts.bytes / spans : 0;
+    char numbers[128];
+    snprintf(numbers, sizeof(numbers), "%13zu %12zu %7.1f%% %12.2f %11.1f", counts.allocations,
+        counts.bytes, percent, allocations_per_span, bytes_per_span);
+    return name + repeat_string(" ", name_width - std::min(name_width, name.size())) + numbers +
+           "\n";
+}
+
+void AllocationReport::write(std::ostream &out) const {
+    size_t total_size = 0;
+    size_t total_spans = 0;
+    std::array<AllocationCounts, phase_count> phases{};
+    AllocationCounts total{};
+    size_t name_width = std::string{"TOTAL"}.size();
+    for (const auto &file : files) {
+        total_size += file.size;
+        total_spans += file.spans;
+        for (size_t i = 0; i < phase_count; i++) {
+            phases[i].allocations += file.phases[i].allocations;
+            phases[i].bytes += file.phases[i].bytes;
+        }
+        total.allocations += file.total.allocations;
+        total.bytes += file.total.bytes;
+        name_width = std::max(name_width, file.filename.size());
+    }
+    for (size_t i = 0; i < phase_count; i++) {
+        name_width = std::max(name_width, std::string{phase_name(static_cast<Phase>(i))}.size());
+    }
+    name_width += 2;
+
+    auto header = [&](const std::string &name) {
+        return name + repeat_string(" ", name_width - name.size()) +
+               "  allocations        bytes   %bytes  allocs/span  bytes/span\n";
+    };
+
+    // Phases that allocated nothing are left out; ideally, that's most of them.
+    std::vector<size_t> order;
+    for (size_t i = 0; i < phase_count; i++) {
+        if (phases[i].allocations > 0) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&](size_t a, size_t b) { return phases[a].bytes > phases[b].bytes; });
+
+    std::ostringstream text;
+    text << "Allocation report for " << files.size() << " file(s), " << total_size << " bytes, "
+         << total_spans << " spans\n\n";
+    text << header("phase");
+    for (size_t i : order) {
+        text << format_row(phase_name(static_cast<Phase>(i)), name_width, total_spans, phases[i],
+            total.bytes);
+    }
+    text << format_row("TOTAL", name_width, total_spans, total, total.bytes);
+
+    std::vector<const FileAllocations *> by_bytes;
+    for (const auto &file : files) {
+        by_bytes.push_back(&file);
+    }
+    std::stable_sort(by_bytes.begin(), by_bytes.end(),
+        [](const FileAllocations *a, const FileAllocations *b) {
+            return a->total.bytes > b->total.bytes;
+        });
+    text << "\n" << header("file");
+    for (const FileAllocations *file : by_bytes) {
+        text << format_row(file->filename, name_width, file->spans, file->total, total.bytes);
+    }
+    out << text.str();
+}
+
+TEST_CASE("Reports allocations by phase and by file") {
+    AllocationReport report;
+    report.begin_file("a.cmake");
+    report.current_file().size = 1000;
+    report.current_file().spans = 100;
+    report.begin_file("b.cmake");
+    report.current_file().size = 3000;
+    report.current_file().spans = 300;
+    // Made-up counts, so the output is predictable.
+    report.files[0].phases[static_cast<size_t>(Phase::Parse)] = {10, 1000};
+    report.files[0].phases[static_cast<size_t>(Phase::Write)] = {1, 1000};
+    report.files[0].total = {11, 2000};
+    report.files[1].phases[static_cast<size_t>(Phase::Parse)] = {30, 6000};
+    report.files[1].total = {30, 6000};
+
+    std::ostringstream out;
+    report.write(out);
+    REQUIRE(out.str() ==
+            "Allocation report for 2 file(s), 4000 bytes, 400 spans\n"
+            "\n"
+            "phase                                   allocations        bytes"
+            "   %bytes  allocs/span  bytes/span\n"
+            "parse                                            40         7000"
+            "    87.5%         0.10        17.5\n"
+            "write                                             1         1000"
+            "    12.5%         0.00         2.5\n"
+            "TOTAL                                            41         8000"
+            "   100.0%         0.10        20.0\n"
+            "\n"
+            "file                                    allocations        bytes"
+            "   %bytes  allocs/span  bytes/span\n"
+            "b.cmake                                          30         6000"
+            "    75.0%         0.10        20.0\n"
+            "a.cmake                                          11         2000"
+            "    25.0%         0.11        20.0\n");
+}
+
+TEST_CASE("Counts allocations in phases") {
+    AllocationReport report;
+    report.begin_file("a.cmake");
+    report.begin_phase(Phase::Parse);
+    std::vector<int> allocated(10);
+    report.end_phase(Phase::Parse);
+    const AllocationCounts &parse = report.files[0].phases[static_cast<size_t>(Phase::Parse)];
+    REQUIRE(parse.allocations == (counting_allocations() ? 1 : 0));
+    REQUIRE(parse.bytes == (counting_allocations() ? sizeof(int) * 10 : 0));
+    REQUIRE(report.files[0].total.allocations == parse.allocations);
+}
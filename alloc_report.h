@@ -0,0 +1,41 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "allocations.h"
+#include "cmakeformat.h"
+
+// Heap allocations made in each phase of formatting each file, for -alloc-report. Only builds
+// that count allocations (see allocations.h) see any.
+struct AllocationReport : PhaseObserver {
+    struct FileAllocations {
+        std::string filename;
+        size_t size = 0;
+        size_t spans = 0;
+        std::array<AllocationCounts, phase_count> phases{};
+        AllocationCounts total{};
+    };
+
+    // Phases are attributed to the most recently begun file. The file size and span count can
+    // be set once they're known, through current_file().
+    void begin_file(const std::string &filename);
+    FileAllocations &current_file();
+
+    void begin_phase(Phase phase) override;
+    void end_phase(Phase phase) override;
+
+    // Writes a table of the allocations in each phase over all files, then one of the
+    // allocations for each file, both by bytes allocated, most first.
+    void write(std::ostream &out) const;
+
+    std::vector<FileAllocations> files;
+    // The thread's counts when the current phase began.
+    AllocationCounts phase_start{};
+};
@@ -0,0 +1,97 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "allocations.h"
+#include "helpers.h"
+
+#ifdef CMAKEFORMAT_COUNT_ALLOCATIONS
+
+static thread_local size_t allocation_count = 0;
+static thread_local size_t allocation_bytes = 0;
+
+static std::atomic<size_t> heap_current{0};
+static std::atomic<size_t> heap_peak{0};
+
+void record_allocation(size_t size) noexcept {
+    allocation_count++;
+    allocation_bytes += size;
+
+    const size_t current = heap_current += size;
+    size_t peak = heap_peak.load(std::memory_order_relaxed);
+    while (current > peak && !heap_peak.compare_exchange_weak(peak, current)) {
+    }
+}
+
+void record_deallocation(size_t size) noexcept {
+    heap_current -= size;
+}
+
+bool counting_allocations() {
+    return true;
+}
+
+AllocationCounts thread_allocations() {
+    return {allocation_count, allocation_bytes};
+}
+
+HeapUsage heap_usage() {
+    return {heap_current.load(), heap_peak.load()};
+}
+
+void reset_peak_heap() {
+    heap_peak = heap_current.load();
+}
+
+#else
+
+bool counting_allocations() {
+    return false;
+}
+
+AllocationCounts thread_allocations() {
+    return {0, 0};
+}
+
+HeapUsage heap_usage() {
+    return {0, 0};
+}
+
+void reset_peak_heap() {
+}
+
+#endif
+
+TEST_CASE("Counts allocations") {
+    if (!counting_allocations()) {
+        return;
+    }
+    const AllocationCounts before = thread_allocations();
+    delete new int{1};
+    delete[] new char[100];
+    const AllocationCounts after = thread_allocations();
+    REQUIRE(after.allocations - before.allocations == 2);
+    REQUIRE(after.bytes - before.bytes == sizeof(int) + 100);
+}
+
+TEST_CASE("Measures peak heap usage") {
+    if (!counting_allocations()) {
+        return;
+    }
+    reset_peak_heap();
+    const HeapUsage before = heap_usage();
+    REQUIRE(before.peak == before.current);
+    {
+        std::vector<char> big(1000000);
+        REQUIRE(heap_usage().current >= before.current + big.size());
+    }
+    const HeapUsage after = heap_usage();
+    REQUIRE(after.current == before.current);
+    REQUIRE(after.peak >= before.current + 1000000);
+    reset_peak_heap();
+    REQUIRE(heap_usage().peak == after.current);
+}
@@ -0,0 +1,38 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <cstddef>
+
+// With CMAKEFORMAT_COUNT_ALLOCATIONS (the CMake option of the same name, and every Debug build,
+// for the tests), the executables that link counted_new.cpp replace global operator new and
+// delete with ones that count the allocations each thread makes, and keep track of how much is
+// allocated at once. The counts are kept here, in the library; anywhere else, they stay zero.
+
+struct AllocationCounts {
+    size_t allocations;
+    size_t bytes;
+};
+
+// Whether this build counts allocations at all.
+bool counting_allocations();
+
+// Allocations made by the calling thread so far; always zero unless counting_allocations().
+AllocationCounts thread_allocations();
+
+// Bytes allocated with operator new and not yet deleted, by all threads, and the most there have
+// been since the last reset_peak_heap(); always zero unless counting_allocations().
+struct HeapUsage {
+    size_t current;
+    size_t peak;
+};
+HeapUsage heap_usage();
+
+// Starts measuring the peak from the current usage.
+void reset_peak_heap();
+
+// Called by the replacement operator new and delete, with the size allocated or freed.
+void record_allocation(size_t size) noexcept;
+void record_deallocation(size_t size) noexcept;
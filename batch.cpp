@@ -0,0 +1,132 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+#include "batch.h"
+#include "helpers.h"
+
+// Reads the next document into content, reusing its storage. Returns false at end of input.
+static bool read_document(std::istream &in, BatchFraming framing, std::string &content) {
+    if (in.peek() == std::char_traits<char>::eof()) {
+        return false;
+    }
+    if (framing == BatchFraming::Nul) {
+        std::getline(in, content, '\0');
+        return true;
+    }
+
+    std::string header;
+    std::getline(in, header);
+    size_t length = 0;
+    try {
+        // std::stoull() would skip leading whitespace and take "-1" as the largest length.
+        if (header.empty() || header[0] < '0' || header[0] > '9') {
+            throw std::invalid_argument{header};
+        }
+        size_t parsed = 0;
+        length = std::stoull(header, &parsed);
+        if (parsed != header.size()) {
+            throw std::invalid_argument{header};
+        }
+    } catch (const std::logic_error &) {
+        throw std::runtime_error("batch: bad document length '" + header + "'");
+    }
+    // Read a chunk at a time, so that a length longer than the input only takes as much memory as
+    // the input has, rather than being allocated up front.
+    static const size_t chunk_size = 1 << 16;
+    content.clear();
+    while (content.size() < length) {
+        const size_t read = content.size();
+        const size_t chunk = std::min(chunk_size, length - read);
+        content.resize(read + chunk);
+        if (!in.read(&content[read], chunk)) {
+            throw std::runtime_error("batch: unexpected end of input");
+        }
+    }
+    return true;
+}
+
+static void write_document(std::ostream &out, BatchFraming framing, const std::string &content) {
+    if (framing == BatchFraming::Length) {
+        out << content.size() << '\n';
+    }
+    out.write(content.data(), content.size());
+    if (framing == BatchFraming::Nul) {
+        out.put('\0');
+    }
+}
+
+size_t run_batch(std::istream &in, std::ostream &out, BatchFraming framing,
+    const std::function<void(const std::string &, std::string &)> &format) {
+    size_t failures = 0;
+    size_t document_index = 0;
+    std::string content;
+    std::string output;
+    while (read_document(in, framing, content)) {
+        try {
+            format(content, output);
+            write_document(out, framing, output);
+        } catch (const std::exception &e) {
+            fprintf(stderr, "document %zu: %s\n", document_index, e.what());
+            write_document(out, framing, content);
+            failures++;
+        }
+        document_index++;
+    }
+    out.flush();
+    return failures;
+}
+
+static inline void fake_format(const std::string &content, std::string &output) {
+    if (content == "bad") {
+        throw std::runtime_error("bad document");
+    }
+    output = upperstring(content);
+}
+
+TEST_CASE("Formats NUL-delimited documents") {
+    const std::string input{"a()\n\0bad\0\0b()", 13};
+    const std::string wanted{"A()\n\0bad\0\0B()\0", 14};
+    std::istringstream in{input};
+    std::ostringstream out;
+    REQUIRE(run_batch(in, out, BatchFraming::Nul, fake_format) == 1);
+    REQUIRE(out.str() == wanted);
+}
+
+TEST_CASE("Formats length-prefixed documents") {
+    std::istringstream in{"4\na()\n3\nbad0\n3\nb()"};
+    std::ostringstream out;
+    REQUIRE(run_batch(in, out, BatchFraming::Length, fake_format) == 1);
+    REQUIRE(out.str() == "4\nA()\n3\nbad0\n3\nB()");
+}
+
+TEST_CASE("Rejects truncated length-prefixed documents") {
+    std::istringstream in{"10\nshort"};
+    std::ostringstream out;
+    REQUIRE_THROWS(run_batch(in, out, BatchFraming::Length, fake_format));
+}
+
+TEST_CASE("Rejects lengths longer than the input without allocating them") {
+    std::istringstream in{"99999999999999\na()"};
+    std::ostringstream out;
+    std::string error;
+    try {
+        run_batch(in, out, BatchFraming::Length, fake_format);
+    } catch (const std::runtime_error &e) {
+        error = e.what();
+    }
+    REQUIRE(error == "batch: unexpected end of input");
+}
+
+TEST_CASE("Rejects bad document lengths") {
+    for (const char *input : {"-1\na()", " 3\na()", "+3\na()", "3x\na()", "\na()"}) {
+        std::istringstream in{input};
+        std::ostringstream out;
+        REQUIRE_THROWS(run_batch(in, out, BatchFraming::Length, fake_format));
+    }
+}
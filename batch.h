@@ -0,0 +1,23 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+
+enum class BatchFraming {
+    // Each document is terminated by a NUL byte (the last one may be unterminated).
+    Nul,
+    // Each document is preceded by its size in bytes, as a decimal number followed by a newline.
+    Length,
+};
+
+// Formats a stream of documents, writing each result with the same framing it was read with.
+// Documents that can't be formatted are reported on stderr and written back unchanged, so the
+// output stays in step with the input. Returns the number of such documents.
+size_t run_batch(std::istream &in, std::ostream &out, BatchFraming framing,
+    const std::function<void(const std::string &, std::string &)> &format);
@@ -0,0 +1,389 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// Times parse(), each transform, and the whole pipeline, over inputs of several sizes.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cmakeformat.h"
+#include "command_line.h"
+#include "corpus.h"
+#include "helpers.h"
+#include "perf_counters.h"
+#include "transform.h"
+
+struct BenchInput {
+    std::string name;
+    std::string content;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string input;
+    size_t bytes;
+    size_t spans;
+    std::vector<double> samples_ns;
+    // With -repetitions, the median of each repetition's samples.
+    std::vector<double> repetition_medians_ns;
+    double median_ns;
+    double min_ns;
+    // Averaged over the timed runs, with -counters.
+    PerfCounters::Counts counts;
+};
+
+// The built-in inputs, made by the corpus generator so that they're the same everywhere.
+static std::string make_input(size_t size, size_t add_library_sources = 0) {
+    CorpusOptions options;
+    options.size = size;
+    options.add_library_sources = add_library_sources;
+    return generate_corpus(options);
+}
+
+// Runs body (after setup, which isn't timed) until it has taken min_seconds in total and run
+// at least min_iterations times, or has run max_iterations times, if that's not 0. The first
+// run only warms up, unless it alone takes min_seconds, in which case repeating it to warm up
+// would just waste time. With counters, also sets counts to the average counts over the timed
+// runs.
+static std::vector<double> time_repeatedly(double min_seconds, size_t min_iterations,
+    size_t max_iterations,
+    const std::function<void()> &setup, const std::function<void()> &body,
+    PerfCounters *counters, PerfCounters::Counts &counts) {
+    using clock = std::chrono::steady_clock;
+    std::vector<double> samples_ns;
+    double total_seconds = 0;
+    bool warming_up = true;
+    counts.values.fill(0);
+    counts.valid.fill(counters != nullptr);
+    while ((samples_ns.size() < min_iterations || total_seconds < min_seconds) &&
+           (max_iterations == 0 || samples_ns.size() < max_iterations)) {
+        setup();
+        if (counters) {
+            counters->start();
+        }
+        const auto start = clock::now();
+        body();
+        const std::chrono::duration<double> elapsed = clock::now() - start;
+        const PerfCounters::Counts run_counts = counters ? counters->stop() : counts;
+        if (warming_up) {
+            warming_up = false;
+            if (elapsed.count() < min_seconds) {
+                continue;
+            }
+        }
+        samples_ns.push_back(elapsed.count() * 1e9);
+        total_seconds += elapsed.count();
+        for (size_t i = 0; counters && i < PerfCounters::counter_count; i++) {
+            counts.values[i] += run_counts.values[i];
+            counts.valid[i] = counts.valid[i] && run_counts.valid[i];
+        }
+    }
+    for (double &value : counts.values) {
+        value /= samples_ns.size();
+    }
+    return samples_ns;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    const size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+static void write_table(const std::vector<BenchResult> &results) {
+    printf("%-36s %-8s %10s %9s %7s %14s %9s %9s\n", "benchmark", "input", "bytes", "spans",
+        "runs", "median ns", "ns/span", "MB/s");
+    for (const auto &r : results) {
+        printf("%-36s %-8s %10zu %9zu %7zu %14.0f %9.2f %9.1f\n", r.name.c_str(),
+            r.input.c_str(), r.bytes, r.spans, r.samples_ns.size(), r.median_ns,
+            r.median_ns / std::max<size_t>(r.spans, 1),
+            r.bytes / (r.median_ns / 1e9) / (1024 * 1024));
+    }
+}
+
+// The counts per span for each counter, and instructions per cycle, or "-" where a counter
+// wasn't available.
+static void write_counters_table(const std::vector<BenchResult> &results) {
+    printf("\n%-36s %-8s %11s %11s %6s %11s %11s %11s\n", "benchmark", "input", "cycles/span",
+        "instr/span", "IPC", "L1 miss/sp", "LLC miss/sp", "br miss/sp");
+    for (const auto &r : results) {
+        auto per_span = [&](PerfCounters::Counter counter) {
+            char text[32] = "-";
+            if (r.counts.valid[counter]) {
+                snprintf(text, sizeof(text), "%.2f",
+                    r.counts.values[counter] / std::max<size_t>(r.spans, 1));
+            }
+            return std::string{text};
+        };
+        const double cycles = r.counts.values[PerfCounters::Cycles];
+        const double instructions = r.counts.values[PerfCounters::Instructions];
+        char ipc[32] = "-";
+        if (r.counts.valid[PerfCounters::Cycles] && r.counts.valid[PerfCounters::Instructions] &&
+            cycles > 0) {
+            snprintf(ipc, sizeof(ipc), "%.2f", instructions / cycles);
+        }
+        printf("%-36s %-8s %11s %11s %6s %11s %11s %11s\n", r.name.c_str(), r.input.c_str(),
+            per_span(PerfCounters::Cycles).c_str(), per_span(PerfCounters::Instructions).c_str(),
+            ipc, per_span(PerfCounters::L1DataMisses).c_str(),
+            per_span(PerfCounters::LastLevelCacheMisses).c_str(),
+            per_span(PerfCounters::BranchMisses).c_str());
+    }
+}
+
+static void write_json(std::ostream &out, const std::vector<BenchResult> &results) {
+    out << "{\"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto &r = results[i];
+        char numbers[256];
+        snprintf(numbers, sizeof(numbers),
+            "\"median_ns\": %.1f, \"min_ns\": %.1f, \"ns_per_span\": %.4f, \"mb_per_second\": "
+            "%.3f",
+            r.median_ns, r.min_ns, r.median_ns / std::max<size_t>(r.spans, 1),
+            r.bytes / (r.median_ns / 1e9) / (1024 * 1024));
+        out << (i == 0 ? "\n" : ",\n") << "  {\"name\": \"";
+        write_json_escaped(out, r.name);
+        out << "\", \"input\": \"";
+        write_json_escaped(out, r.input);
+        out << "\", \"bytes\": " << r.bytes << ", \"spans\": " << r.spans
+            << ", \"iterations\": " << r.samples_ns.size() << ", " << numbers
+            << ", \"samples_ns\": [";
+        for (size_t j = 0; j < r.samples_ns.size(); j++) {
+            snprintf(numbers, sizeof(numbers), "%.0f", r.samples_ns[j]);
+            out << (j == 0 ? "" : ", ") << numbers;
+        }
+        out << "]";
+        if (r.repetition_medians_ns.size() > 1) {
+            out << ", \"repetition_medians_ns\": [";
+            for (size_t j = 0; j < r.repetition_medians_ns.size(); j++) {
+                snprintf(numbers, sizeof(numbers), "%.0f", r.repetition_medians_ns[j]);
+                out << (j == 0 ? "" : ", ") << numbers;
+            }
+            out << "]";
+        }
+        if (std::any_of(r.counts.valid.begin(), r.counts.valid.end(), [](bool v) { return v; })) {
+            out << ", \"counters\": {";
+            bool first = true;
+            for (size_t c = 0; c < PerfCounters::counter_count; c++) {
+                if (r.counts.valid[c]) {
+                    snprintf(numbers, sizeof(numbers), "%.0f", r.counts.values[c]);
+                    out << (first ? "" : ", ") << "\""
+                        << counter_name(static_cast<PerfCounters::Counter>(c)) << "\": " << numbers;
+                    first = false;
+                }
+            }
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    bool use_counters = false;
+    size_t min_milliseconds = 200;
+    size_t min_iterations = 3;
+    size_t max_iterations = 0;
+    size_t repetitions = 1;
+    std::string filter;
+    std::string input_filter;
+    std::string json_filename;
+
+    const static std::string description =
+        "Times parse(), each transform_*, and the whole formatting pipeline, on built-in inputs\n"
+        "of three sizes (small, medium, huge) and one command with 100000 arguments (wide), or\n"
+        "on the specified files instead. Reports the median time per run, per span, and\n"
+        "throughput.";
+    static std::vector<SwitchOptionDescription> switch_options = {
+        {"-counters",
+            "Also read hardware counters (cycles, instructions, L1 and last level cache misses, "
+            "branch misses) through perf_event_open, and report them per span, with IPC.",
+            use_counters},
+        {"-json", "Write results as JSON, including every sample.", json},
+    };
+    const static std::vector<ArgumentOptionDescription> argument_options = {
+        {"-filter", "TEXT", "Only run benchmarks whose name contains TEXT.",
+            [&](const std::string &value) { filter = value; }},
+        {"-input", "NAME", "Only run on the built-in input NAME: small, medium, huge or wide.",
+            [&](const std::string &value) {
+                if (value != "small" && value != "medium" && value != "huge" && value != "wide") {
+                    throw opterror;
+                }
+                input_filter = value;
+            }},
+        {"-json-file", "FILE", "Also write the results as JSON to FILE.",
+            [&](const std::string &value) { json_filename = value; }},
+        {"-max-iterations", "NUMBER",
+            "Run each benchmark at most NUMBER times, even if that takes less than -min-time.",
+            parse_numeric_option(max_iterations)},
+        {"-min-iterations", "NUMBER", "Run each benchmark at least NUMBER times.",
+            parse_numeric_option(min_iterations)},
+        {"-min-time", "MILLISECONDS", "Run each benchmark for at least MILLISECONDS.",
+            parse_numeric_option(min_milliseconds)},
+        {"-repetitions", "NUMBER",
+            "Run the whole suite NUMBER times over. The JSON also has the median of each "
+            "benchmark in each repetition.",
+            parse_numeric_option(repetitions)},
+    };
+    const std::vector<std::string> filenames =
+        parse_command_line(argc, argv, description, switch_options, argument_options);
+
+    std::vector<BenchInput> inputs;
+    if (filenames.empty()) {
+        inputs.push_back({"small", make_input(2 * 1024)});
+        inputs.push_back({"medium", make_input(64 * 1024)});
+        inputs.push_back({"huge", make_input(1024 * 1024)});
+        inputs.push_back({"wide", make_input(0, 100 * 1000)});
+        inputs.erase(std::remove_if(inputs.begin(), inputs.end(),
+                         [&](const BenchInput &input) {
+                             return !input_filter.empty() && input.name != input_filter;
+                         }),
+            inputs.end());
+    }
+    for (const auto &filename : filenames) {
+        std::ifstream file{filename, std::ios::binary};
+        if (!file) {
+            fprintf(stderr, "%s: can't read '%s'\n", argv[0], filename.c_str());
+            return 1;
+        }
+        inputs.push_back({filename, {std::istreambuf_iterator<char>(file),
+                                        std::istreambuf_iterator<char>()}});
+    }
+
+    // Benchmarks still run, with timing only, if the counters can't be read.
+    PerfCounters perf_counters;
+    PerfCounters *counters = nullptr;
+    if (use_counters && !perf_counters.any_available()) {
+        fprintf(stderr, "%s: %s; timing only\n", argv[0], perf_counters.error.c_str());
+    } else if (use_counters) {
+        counters = &perf_counters;
+        if (!perf_counters.error.empty()) {
+            fprintf(stderr, "%s: %s\n", argv[0], perf_counters.error.c_str());
+        }
+    }
+
+    const double min_seconds = min_milliseconds / 1000.0;
+    const std::string indent_string = "    ";
+    const size_t column_limit = 80;
+    std::vector<BenchResult> results;
+
+    // The whole suite is run again on each repetition, so that the repetitions are spread out
+    // in time, and whatever else the machine was doing shows up as a difference between them.
+    for (size_t repetition = 0; repetition < repetitions; repetition++) {
+        for (const auto &input : inputs) {
+            // The spans each transform starts from: the output of everything before it in the
+            // pipeline. Copying them back in is setup, and isn't timed.
+            std::vector<Span> parsed;
+            try {
+                parsed = parse(input.content);
+            } catch (const parseexception &e) {
+                fprintf(stderr, "%s: %s: %s\n", argv[0], input.name.c_str(), e.what());
+                return 1;
+            }
+            std::vector<Span> indented = parsed;
+            transform_indent(indented, indent_string);
+            std::vector<Span> loosened = indented;
+            transform_loosen_loop_constructs(loosened);
+            std::vector<Span> reflowed = loosened;
+            transform_argument_bin_pack(reflowed, column_limit, indent_string);
+
+            std::vector<Span> spans;
+            ParseContext parse_context;
+            auto run = [&](const std::string &name, const std::vector<Span> *start,
+                           const std::function<void()> &body) {
+                if (name.find(filter) == std::string::npos) {
+                    return;
+                }
+                PerfCounters::Counts counts;
+                const auto samples = time_repeatedly(min_seconds, min_iterations, max_iterations,
+                    [&] {
+                        if (start) {
+                            spans = *start;
+                        }
+                    },
+                    body, counters, counts);
+                auto result = std::find_if(results.begin(), results.end(),
+                    [&](const BenchResult &r) { return r.name == name && r.input == input.name; });
+                if (result == results.end()) {
+                    results.push_back({name, input.name, input.content.size(), parsed.size(), {},
+                        {}, 0, 0, counts});
+                    result = results.end() - 1;
+                }
+                // Counts are averaged over every timed run.
+                const size_t earlier_runs = result->samples_ns.size();
+                for (size_t i = 0; i < PerfCounters::counter_count; i++) {
+                    double &value = result->counts.values[i];
+                    value = (value * earlier_runs + counts.values[i] * samples.size()) /
+                            (earlier_runs + samples.size());
+                    result->counts.valid[i] = result->counts.valid[i] && counts.valid[i];
+                }
+                result->samples_ns.insert(result->samples_ns.end(), samples.begin(), samples.end());
+                result->repetition_medians_ns.push_back(median(samples));
+                if (!json) {
+                    fprintf(stderr, "%s/%s done\n", name.c_str(), input.name.c_str());
+                }
+            };
+
+            run("parse", nullptr, [&] { parse(input.content, spans, parse_context); });
+            run("transform_indent", &parsed, [&] { transform_indent(spans, indent_string); });
+            run("transform_indent_rparen", &indented,
+                [&] { transform_indent_rparen(spans, indent_string); });
+            run("transform_loosen_loop_constructs", &indented,
+                [&] { transform_loosen_loop_constructs(spans); });
+            run("transform_argument_bin_pack", &loosened,
+                [&] { transform_argument_bin_pack(spans, column_limit, indent_string); });
+            run("transform_argument_bin_pack_balanced", &loosened, [&] {
+                transform_argument_bin_pack_balanced(spans, column_limit, indent_string);
+            });
+            run("transform_argument_per_line", &loosened,
+                [&] { transform_argument_per_line(spans, indent_string); });
+            run("transform_argument_heuristic", &loosened, [&] {
+                transform_argument_heuristic(
+                    spans, column_limit, indent_string, builtin_command_signatures());
+            });
+            run("transform_command_case", &reflowed,
+                [&] { transform_command_case(spans, LetterCase::Lower); });
+            run("transform_squash_empty_lines", &reflowed,
+                [&] { transform_squash_empty_lines(spans, 1); });
+            run("transform_space_before_parens", &reflowed, [&] {
+                transform_space_before_parens(spans, SpaceBeforeParens::ControlStatements);
+            });
+
+            FormatOptions options;
+            options.reflow_arguments = ReflowArguments::BinPack;
+            options.column_limit = column_limit;
+            FormatContext context;
+            std::string output;
+            run("format", nullptr, [&] { format(input.content, options, output, context); });
+        }
+    }
+    for (auto &r : results) {
+        r.median_ns = median(r.samples_ns);
+        r.min_ns = *std::min_element(r.samples_ns.begin(), r.samples_ns.end());
+    }
+
+    if (!json_filename.empty()) {
+        std::ofstream json_file{json_filename};
+        write_json(json_file, results);
+        if (!json_file) {
+            fprintf(stderr, "%s: can't write '%s'\n", argv[0], json_filename.c_str());
+            return 1;
+        }
+    }
+    if (json) {
+        write_json(std::cout, results);
+    } else {
+        write_table(results);
+        if (counters) {
+            write_counters_table(results);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,408 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// Compares runs of cmake-format-bench saved with -json or -json-file: for each benchmark on each
+// input, the median time in every run, and how much faster each run is than the first. With
+// -max-regression, checks one run against a baseline instead, and fails if it got slower.
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "command_line.h"
+
+// Just enough JSON to read what cmake-format-bench writes.
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object };
+    Type type = Null;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    // The member called name, or a null value if there's none.
+    const JsonValue &operator[](const std::string &name) const {
+        static const JsonValue null;
+        for (const auto &member : object) {
+            if (member.first == name) {
+                return member.second;
+            }
+        }
+        return null;
+    }
+};
+
+struct JsonReader {
+    explicit JsonReader(const std::string &text_) : text(text_) {
+    }
+
+    JsonValue read_document() {
+        JsonValue value = read_value();
+        skip_space();
+        if (position != text.size()) {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+    JsonValue read_value() {
+        skip_space();
+        JsonValue value;
+        if (position >= text.size()) {
+            fail("unexpected end");
+        }
+        const char c = text[position];
+        if (c == '{') {
+            value.type = JsonValue::Object;
+            position++;
+            if (!consume('}')) {
+                do {
+                    skip_space();
+                    std::string name = read_string();
+                    expect(':');
+                    value.object.emplace_back(std::move(name), read_value());
+                } while (consume(','));
+                expect('}');
+            }
+        } else if (c == '[') {
+            value.type = JsonValue::Array;
+            position++;
+            if (!consume(']')) {
+                do {
+                    value.array.push_back(read_value());
+                } while (consume(','));
+                expect(']');
+            }
+        } else if (c == '"') {
+            value.type = JsonValue::String;
+            value.string = read_string();
+        } else if (text.compare(position, 4, "true") == 0 ||
+                   text.compare(position, 5, "false") == 0) {
+            value.type = JsonValue::Bool;
+            value.number = c == 't';
+            position += c == 't' ? 4 : 5;
+        } else if (text.compare(position, 4, "null") == 0) {
+            position += 4;
+        } else {
+            const char *start = text.c_str() + position;
+            char *end;
+            value.type = JsonValue::Number;
+            value.number = strtod(start, &end);
+            if (end == start) {
+                fail("unexpected character");
+            }
+            position += end - start;
+        }
+        return value;
+    }
+
+  private:
+    std::string read_string() {
+        expect('"');
+        std::string value;
+        while (position < text.size() && text[position] != '"') {
+            char c = text[position++];
+            if (c == '\\' && position < text.size()) {
+                c = text[position++];
+                if (c == 'n') {
+                    c = '\n';
+                } else if (c == 't') {
+                    c = '\t';
+                } else if (c == 'u') {
+                    // Only ever control characters, from write_json_escaped().
+                    c = static_cast<char>(strtol(text.substr(position, 4).c_str(), nullptr, 16));
+                    position += 4;
+                }
+            }
+            value += c;
+        }
+        expect('"');
+        return value;
+    }
+
+    void skip_space() {
+        while (position < text.size() && isspace(static_cast<unsigned char>(text[position]))) {
+            position++;
+        }
+    }
+
+    bool consume(char c) {
+        skip_space();
+        if (position < text.size() && text[position] == c) {
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) {
+            fail(std::string{"expected '"} + c + "'");
+        }
+    }
+
+    void fail(const std::string &message) {
+        throw std::runtime_error{message + " at offset " + std::to_string(position)};
+    }
+
+    const std::string &text;
+    size_t position = 0;
+};
+
+// One benchmark on one input, in one run of cmake-format-bench.
+struct BenchTimes {
+    double bytes;
+    double median_ns;
+    // What confidence intervals are computed from: the median of each repetition, with
+    // -repetitions, which also captures the machine getting busier or quieter over the run; or
+    // else each sample.
+    std::vector<double> samples_ns;
+};
+
+// One run of cmake-format-bench, by benchmark and input.
+struct BenchRun {
+    std::string name;
+    std::map<std::pair<std::string, std::string>, BenchTimes> benchmarks;
+};
+
+static BenchRun read_run(const std::string &filename) {
+    std::ifstream file{filename, std::ios::binary};
+    if (!file) {
+        throw std::runtime_error{"can't read '" + filename + "'"};
+    }
+    const std::string text{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    JsonValue document;
+    try {
+        document = JsonReader{text}.read_document();
+    } catch (const std::runtime_error &e) {
+        throw std::runtime_error{filename + ": " + e.what()};
+    }
+
+    BenchRun run;
+    run.name = filename.substr(filename.find_last_of("/\\") + 1);
+    run.name = run.name.substr(0, run.name.rfind(".json"));
+    for (const auto &benchmark : document["benchmarks"].array) {
+        BenchTimes &times = run.benchmarks[{benchmark["name"].string, benchmark["input"].string}];
+        times.bytes = benchmark["bytes"].number;
+        times.median_ns = benchmark["median_ns"].number;
+        const JsonValue &repetitions = benchmark["repetition_medians_ns"];
+        const JsonValue &samples =
+            repetitions.array.size() > 1 ? repetitions : benchmark["samples_ns"];
+        for (const auto &sample : samples.array) {
+            times.samples_ns.push_back(sample.number);
+        }
+    }
+    if (run.benchmarks.empty()) {
+        throw std::runtime_error{filename + ": no benchmarks"};
+    }
+    return run;
+}
+
+// The two-sided 95% critical value of Student's t distribution.
+static double t_critical_95(double degrees_of_freedom) {
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+        2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080,
+        2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (degrees_of_freedom <= 30) {
+        // Rounded down, so the interval errs on the wide side.
+        return table[static_cast<size_t>(std::max(degrees_of_freedom, 1.0)) - 1];
+    }
+    return 1.960 + 2.4 / degrees_of_freedom;
+}
+
+// The change in throughput from baseline to current, as a fraction (-0.1 is 10% slower), with
+// a 95% confidence interval from Welch's t-test on the mean time per byte of their samples.
+struct ThroughputChange {
+    double baseline_mb_per_second;
+    double mb_per_second;
+    double change;
+    double low;
+    double high;
+};
+
+static ThroughputChange throughput_change(const BenchTimes &baseline, const BenchTimes &current) {
+    double means[2];
+    double variances_of_mean[2];
+    double sizes[2];
+    const BenchTimes *both[2] = {&baseline, &current};
+    for (size_t i = 0; i < 2; i++) {
+        const std::vector<double> &samples = both[i]->samples_ns;
+        const double n = samples.size();
+        double sum = 0;
+        for (double sample : samples) {
+            sum += sample;
+        }
+        const double mean = sum / n;
+        double squares = 0;
+        for (double sample : samples) {
+            squares += (sample - mean) * (sample - mean);
+        }
+        means[i] = mean / both[i]->bytes;
+        variances_of_mean[i] = squares / (n - 1) / n / (both[i]->bytes * both[i]->bytes);
+        sizes[i] = n;
+    }
+
+    // Of the time per byte, then turned into throughput, which goes the other way.
+    const double time_change = means[1] / means[0] - 1;
+    const double variance = variances_of_mean[0] + variances_of_mean[1];
+    const double degrees_of_freedom =
+        variance * variance / (variances_of_mean[0] * variances_of_mean[0] / (sizes[0] - 1) +
+                                  variances_of_mean[1] * variances_of_mean[1] / (sizes[1] - 1));
+    const double margin =
+        variance == 0 ? 0 : t_critical_95(degrees_of_freedom) * std::sqrt(variance) / means[0];
+    const double slowest = time_change + margin;
+    const double fastest = time_change - margin;
+    const double mb = 1024 * 1024;
+    return {1e9 / mb / means[0], 1e9 / mb / means[1], 1 / (1 + time_change) - 1,
+        1 / (1 + slowest) - 1, fastest <= -1 ? INFINITY : 1 / (1 + fastest) - 1};
+}
+
+// Whether a benchmark fails the check when it regresses: parse, each transform, and the
+// pipeline.
+static bool is_checked(const std::string &name) {
+    return name == "parse" || name == "format" || name.compare(0, 10, "transform_") == 0;
+}
+
+// Compares current with baseline benchmark by benchmark, and returns how many checked ones
+// lost more than max_regression of their throughput, with 95% confidence.
+static size_t check_regressions(
+    const BenchRun &baseline, const BenchRun &current, double max_regression) {
+    printf("%-36s %-8s %13s %12s %8s %20s\n", "benchmark", "input", "baseline MB/s", "MB/s",
+        "change", "95% interval");
+    size_t regressions = 0;
+    for (const auto &before : baseline.benchmarks) {
+        const auto after = current.benchmarks.find(before.first);
+        printf("%-36s %-8s", before.first.first.c_str(), before.first.second.c_str());
+        if (after == current.benchmarks.end()) {
+            printf(" not run\n");
+            continue;
+        }
+        if (before.second.samples_ns.size() < 2 || after->second.samples_ns.size() < 2) {
+            printf(" too few samples\n");
+            continue;
+        }
+        const ThroughputChange change = throughput_change(before.second, after->second);
+        printf(" %13.1f %12.1f %+7.1f%%   [%+6.1f%%, %+6.1f%%]", change.baseline_mb_per_second,
+            change.mb_per_second, change.change * 100, change.low * 100,
+            std::min(change.high * 100, 999.9));
+        if (is_checked(before.first.first) && change.high < -max_regression) {
+            printf("  REGRESSED");
+            regressions++;
+        } else if (change.high < 0) {
+            printf("  slower");
+        } else if (change.low > 0) {
+            printf("  faster");
+        }
+        printf("\n");
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    const static std::string description =
+        "Compares runs of cmake-format-bench saved with -json-file, the first one being the\n"
+        "baseline: for each benchmark on each input, the median time in every run, and how\n"
+        "many times faster than the baseline it is (above 1 is faster). With -max-regression,\n"
+        "checks one run against the baseline instead.";
+    size_t max_regression_percent = 0;
+    bool checking = false;
+    static std::vector<SwitchOptionDescription> switch_options = {};
+    const static std::vector<ArgumentOptionDescription> argument_options = {
+        {"-max-regression", "PERCENT",
+            "Compare exactly one run with the baseline, by the throughput of each benchmark with "
+            "a 95% confidence interval from their samples, and fail if parse, any transform or "
+            "format lost more than PERCENT with that confidence.",
+            [&](const std::string &value) {
+                parse_numeric_option(max_regression_percent)(value);
+                checking = true;
+            }},
+    };
+    const std::vector<std::string> filenames =
+        parse_command_line(argc, argv, description, switch_options, argument_options);
+    if (filenames.size() < 2 || (checking && filenames.size() != 2)) {
+        fprintf(stderr, "usage: %s [options] BASELINE.json OTHER.json... Try: %s -help\n",
+            argv[0], argv[0]);
+        return 1;
+    }
+
+    std::vector<BenchRun> runs;
+    try {
+        for (const auto &filename : filenames) {
+            runs.push_back(read_run(filename));
+        }
+    } catch (const std::runtime_error &e) {
+        fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        return 1;
+    }
+
+    if (checking) {
+        const size_t regressions =
+            check_regressions(runs[0], runs[1], max_regression_percent / 100.0);
+        if (regressions > 0) {
+            printf("%zu benchmarks lost more than %zu%% of their throughput\n", regressions,
+                max_regression_percent);
+            return 1;
+        }
+        return 0;
+    }
+
+    printf("%-36s %-8s", "benchmark", "input");
+    for (size_t i = 0; i < runs.size(); i++) {
+        printf(" %14s", (runs[i].name.substr(0, 10) + " ns").c_str());
+        if (i > 0) {
+            printf(" %8s", "speedup");
+        }
+    }
+    printf("\n");
+
+    // Only benchmarks in every run are compared.
+    std::vector<double> log_speedup_sums(runs.size());
+    size_t compared = 0;
+    for (const auto &baseline : runs[0].benchmarks) {
+        std::vector<double> medians;
+        for (const auto &run : runs) {
+            const auto found = run.benchmarks.find(baseline.first);
+            if (found == run.benchmarks.end() || found->second.median_ns <= 0) {
+                break;
+            }
+            medians.push_back(found->second.median_ns);
+        }
+        if (medians.size() != runs.size()) {
+            continue;
+        }
+        compared++;
+        printf("%-36s %-8s", baseline.first.first.c_str(), baseline.first.second.c_str());
+        for (size_t i = 0; i < runs.size(); i++) {
+            printf(" %14.0f", medians[i]);
+            if (i > 0) {
+                printf(" %7.3fx", medians[0] / medians[i]);
+                log_speedup_sums[i] += std::log(medians[0] / medians[i]);
+            }
+        }
+        printf("\n");
+    }
+    if (compared == 0) {
+        fprintf(stderr, "%s: no benchmark is in every run\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-45s", "geometric mean");
+    for (size_t i = 0; i < runs.size(); i++) {
+        printf(" %14s", "");
+        if (i > 0) {
+            printf(" %7.3fx", std::exp(log_speedup_sums[i] / compared));
+        }
+    }
+    printf("\n");
+    return 0;
+}
@@ -3,25 +3,36 @@
    details.  */
 
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstdio>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <memory>
-#include <regex>
 #include <string>
 #include <utility>
 #include <vector>
 
-#ifdef CMAKEFORMAT_BUILD_TESTS
-#define DOCTEST_CONFIG_IMPLEMENT
-#include <doctest/doctest.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
 #endif
 
+#include "alloc_report.h"
+#include "batch.h"
+#include "cmakeformat.h"
 #include "command_line.h"
+#include "diff.h"
+#include "git_filter.h"
 #include "helpers.h"
-#include "parser.h"
-#include "transform.h"
+#include "memory_report.h"
+#include "replacements.h"
+#include "stats.h"
+#include "time_report.h"
+#include "trace.h"
 
 struct inputwrapper {
     inputwrapper() : standard{true} {
@@ -63,32 +74,98 @@ struct outputwrapper {
     std::ofstream file;
 };
 
-enum class ReflowArguments {
-    None,
-    OnePerLine,
-    BinPack,
-    Heuristic,
+// Reads a whole file, or standard input for "-", into content; a file that can't be read reads
+// as empty. Through stdio rather than a std::ifstream, whose first use costs a noticeable part of
+// the time to format a small file.
+static void read_file(const std::string &filename, std::string &content) {
+    content.clear();
+    FILE *file = filename == "-" ? stdin : fopen(filename.c_str(), "r");
+    if (!file) {
+        return;
+    }
+    char buffer[64 * 1024];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, size);
+    }
+    if (file != stdin) {
+        fclose(file);
+    }
+}
+
+// Passes phases on to each of several observers.
+struct PhaseObservers : PhaseObserver {
+    void begin_phase(Phase phase) override {
+        for (PhaseObserver *observer : observers) {
+            observer->begin_phase(phase);
+        }
+    }
+    void end_phase(Phase phase) override {
+        for (PhaseObserver *observer : observers) {
+            observer->end_phase(phase);
+        }
+    }
+
+    std::vector<PhaseObserver *> observers;
 };
 
+// Roughly the most memory formatting takes, as a multiple of the input size: the input and its
+// copy in the lexer, the spans (about 20 times the input on typical files, and up to 30 with
+// ReflowArguments::OnePerLine) and the output.
+static const size_t memory_per_input_byte = 40;
+
+// The size of a file, or the largest size_t for standard input and files whose size can't be
+// found.
+static size_t file_size(const std::string &filename) {
+    if (filename == "-") {
+        return std::numeric_limits<size_t>::max();
+    }
+    std::ifstream file{filename, std::ios::binary | std::ios::ate};
+    const std::streamoff size = file ? static_cast<std::streamoff>(file.tellg()) : -1;
+    return size < 0 ? std::numeric_limits<size_t>::max() : static_cast<size_t>(size);
+}
+
+// Renames from to to, replacing any file already there.
+static bool replace_file(const std::string &from, const std::string &to) {
+#ifdef _WIN32
+    // rename() won't replace an existing file on Windows.
+    std::remove(to.c_str());
+#endif
+    return std::rename(from.c_str(), to.c_str()) == 0;
+}
+
+static void set_binary_mode(FILE *file) {
+#ifdef _WIN32
+    _setmode(_fileno(file), _O_BINARY);
+#else
+    (void)file;
+#endif
+}
+
 int main(int argc, char **argv) {
 #ifdef CMAKEFORMAT_BUILD_TESTS
     if (argc >= 2 && std::string{argv[1]} == "-self-test") {
-        doctest::Context context;
-        context.applyCommandLine(argc - 1, argv + 1);
-        return context.run();
+        return run_self_test(argc - 1, argv + 1);
     }
 #endif
 
-    size_t column_limit{80};
-    LetterCase command_case{LetterCase::Lower};
-    size_t continuation_indent_width{0};
-    size_t indent_width{4};
-    size_t max_empty_lines_to_keep{1};
-    ReflowArguments reflow_arguments{ReflowArguments::None};
-    SpaceBeforeParens space_before_parens{SpaceBeforeParens::Never};
+    FormatOptions options;
 
     bool quiet = false;
     bool format_in_place = false;
+    bool git_filter_process = false;
+    bool output_diff = false;
+    bool stats = false;
+    bool time_report = false;
+    bool alloc_report = false;
+    bool memory_report = false;
+    size_t max_memory_megabytes = 0;
+    std::string trace_filename;
+    std::string command_signatures_filename;
+    bool batch = false;
+    BatchFraming batch_framing{BatchFraming::Nul};
+    bool output_replacements = false;
+    ReplacementsFormat replacements_format{ReplacementsFormat::Json};
 
     const static std::string description =
         "Re-formats specified files. If no files are specified on the command-line,\n"
@@ -98,6 +175,31 @@ int main(int argc, char **argv) {
     static std::vector<SwitchOptionDescription> switch_options = {
         {"-i", "Re-format files in-place.", format_in_place},
         {"-q", "Quiet mode: suppress informational messages.", quiet},
+        {"-diff",
+            "Instead of the formatted files, write a unified diff from each file to its formatted "
+            "version. Exits with status 1 if any file would change.",
+            output_diff},
+        {"-git-filter-process",
+            "Run as a git long-running filter process (filter.<driver>.process), formatting "
+            "every file that is cleaned or smudged.",
+            git_filter_process},
+        {"-stats",
+            "Instead of formatting, parse each file and report its size, spans, commands, "
+            "nesting and line lengths, then rank the files by span count and parse time per "
+            "byte.",
+            stats},
+        {"-time-report",
+            "Write the wall and CPU time spent in each phase of formatting, for each file and in "
+            "total, to stderr.",
+            time_report},
+        {"-alloc-report",
+            "Write the heap allocations made in each phase of formatting, for each file and in "
+            "total, to stderr. Needs a build with CMAKEFORMAT_COUNT_ALLOCATIONS.",
+            alloc_report},
+        {"-memory-report",
+            "Write the peak heap (with CMAKEFORMAT_COUNT_ALLOCATIONS) and resident memory while "
+            "formatting each file to stderr.",
+            memory_report},
     };
 
 #ifdef CMAKEFORMAT_BUILD_TESTS
@@ -110,23 +212,48 @@ int main(int argc, char **argv) {
 #endif
 
     const static std::vector<ArgumentOptionDescription> argument_options = {
+        {"-batch", "FRAMING",
+            "Format a stream of documents from stdin to stdout. Available: nul (each document is "
+            "terminated by a NUL byte), length (each document is preceded by its size in bytes "
+            "and a newline)",
+            [&](const std::string &value) {
+                batch = true;
+                if (value == "nul") {
+                    batch_framing = BatchFraming::Nul;
+                } else if (value == "length") {
+                    batch_framing = BatchFraming::Length;
+                } else {
+                    throw opterror;
+                }
+            }},
         {"-column-limit", "NUMBER",
             "Set maximum column width to NUMBER. If ReflowArguments is None, this does nothing.",
-            parse_numeric_option(column_limit)},
+            parse_numeric_option(options.column_limit)},
         {"-command-case", "CASE", "Letter case of command invocations. Available: lower, upper",
             [&](const std::string &value) {
                 if (value == "lower") {
-                    command_case = LetterCase::Lower;
+                    options.command_case = LetterCase::Lower;
                 } else if (value == "upper") {
-                    command_case = LetterCase::Upper;
+                    options.command_case = LetterCase::Upper;
                 } else {
                     throw opterror;
                 }
             }},
+        {"-command-signatures", "FILE",
+            "Also read signatures of commands, which the heuristic reflow groups arguments by, "
+            "from FILE. Each is a command whose arguments are how many positional arguments it "
+            "takes, then its options, one-value and multi-value keywords, as lists, like: "
+            "my_command(1 \"OPTION\" \"ONE_VALUE\" \"MULTI;VALUE\")",
+            [&](const std::string &value) {
+                if (value.empty()) {
+                    throw opterror;
+                }
+                command_signatures_filename = value;
+            }},
         {"-continuation-indent-width", "NUMBER", "Indent width for line continuations.",
-            parse_numeric_option(continuation_indent_width)},
+            parse_numeric_option(options.continuation_indent_width)},
         {"-indent-width", "NUMBER", "Use NUMBER spaces for indentation.",
-            parse_numeric_option(indent_width)},
+            parse_numeric_option(options.indent_width)},
         {"-loosen-loop-constructs", "always",
             "Remove closing construct arguments in else(), endif(), etc. Always enabled.",
             [&](const std::string &value) {
@@ -136,19 +263,39 @@ int main(int argc, char **argv) {
             }},
         {"-max-empty-lines-to-keep", "NUMBER",
             "The maximum number of consecutive empty lines to keep.",
-            parse_numeric_option(max_empty_lines_to_keep)},
+            parse_numeric_option(options.max_empty_lines_to_keep)},
+        {"-max-memory", "MEGABYTES",
+            "Keep memory use under MEGABYTES by formatting big files a piece at a time, cut "
+            "between top-level commands, instead of reading them in whole. The output is the "
+            "same.",
+            parse_numeric_option(max_memory_megabytes)},
+        {"-output-replacements", "FORMAT",
+            "Instead of the formatted file, write the edits that would format it, as (offset, "
+            "length, text) triples. Only one file can be given. Available: json, xml",
+            [&](const std::string &value) {
+                output_replacements = true;
+                if (value == "json") {
+                    replacements_format = ReplacementsFormat::Json;
+                } else if (value == "xml") {
+                    replacements_format = ReplacementsFormat::Xml;
+                } else {
+                    throw opterror;
+                }
+            }},
         {"-reflow-arguments", "ALGORITHM",
             "Algorithm to reflow command arguments. Available: none, oneperline, binpack, "
-            "heuristic",
+            "heuristic, binpackbalanced (like binpack, but with lines about even)",
             [&](const std::string &value) {
                 if (value == "none") {
-                    reflow_arguments = ReflowArguments::None;
+                    options.reflow_arguments = ReflowArguments::None;
                 } else if (value == "oneperline") {
-                    reflow_arguments = ReflowArguments::OnePerLine;
+                    options.reflow_arguments = ReflowArguments::OnePerLine;
                 } else if (value == "binpack") {
-                    reflow_arguments = ReflowArguments::BinPack;
+                    options.reflow_arguments = ReflowArguments::BinPack;
                 } else if (value == "heuristic") {
-                    reflow_arguments = ReflowArguments::Heuristic;
+                    options.reflow_arguments = ReflowArguments::Heuristic;
+                } else if (value == "binpackbalanced") {
+                    options.reflow_arguments = ReflowArguments::BinPackBalanced;
                 } else {
                     throw opterror;
                 }
@@ -158,15 +305,24 @@ int main(int argc, char **argv) {
             "never",
             [&](const std::string &value) {
                 if (value == "always") {
-                    space_before_parens = SpaceBeforeParens::Always;
+                    options.space_before_parens = SpaceBeforeParens::Always;
                 } else if (value == "controlstatements") {
-                    space_before_parens = SpaceBeforeParens::ControlStatements;
+                    options.space_before_parens = SpaceBeforeParens::ControlStatements;
                 } else if (value == "never") {
-                    space_before_parens = SpaceBeforeParens::Never;
+                    options.space_before_parens = SpaceBeforeParens::Never;
                 } else {
                     throw opterror;
                 }
             }},
+        {"-trace", "FILE",
+            "Write a Chrome trace (for chrome://tracing or ui.perfetto.dev) of the time spent "
+            "formatting each file, and in each phase, to FILE.",
+            [&](const std::string &value) {
+                if (value.empty()) {
+                    throw opterror;
+                }
+                trace_filename = value;
+            }},
 
         // {"-indent-rparen=STRING", "Use STRING for indenting hanging right-parens."},
         // {"-argument-per-line=STRING", "Put each argument on its own line, indented by STRING."},
@@ -177,8 +333,96 @@ int main(int argc, char **argv) {
     std::vector<std::string> filenames =
         parse_command_line(argc, argv, description, switch_options, argument_options);
 
-    if (continuation_indent_width == 0) {
-        continuation_indent_width = indent_width;
+    // Loaded once, before anything is formatted, on top of the built-in ones.
+    CommandSignatures command_signatures;
+    if (!command_signatures_filename.empty()) {
+        std::ifstream file{command_signatures_filename, std::ios::binary};
+        if (!file) {
+            fprintf(stderr, "%s: can't read '%s'\n", argv[0], command_signatures_filename.c_str());
+            exit(1);
+        }
+        const std::string content{
+            std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        std::string error;
+        if (!command_signatures.load(content, error)) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], command_signatures_filename.c_str(),
+                error.c_str());
+            exit(1);
+        }
+        options.command_signatures = &command_signatures;
+    }
+
+    // Scratch space shared by every document formatted by this process.
+    FormatContext context;
+    auto format_document = [&](const std::string &content, std::string &output) {
+        format(content, options, output, context);
+    };
+
+    if ((time_report || alloc_report || memory_report || max_memory_megabytes != 0 ||
+            !trace_filename.empty()) &&
+        (batch || git_filter_process)) {
+        fprintf(stderr,
+            "%s: '-time-report', '-alloc-report', '-memory-report', '-max-memory' and '-trace' "
+            "can't be used with '-batch' or "
+            "'-git-filter-process'. Try: %s -help\n",
+            argv[0], argv[0]);
+        exit(1);
+    }
+
+    if (batch) {
+        if (filenames.size() != 0 || format_in_place || git_filter_process) {
+            fprintf(stderr, "%s: '-batch' takes no filenames. Try: %s -help\n", argv[0], argv[0]);
+            exit(1);
+        }
+        set_binary_mode(stdin);
+        set_binary_mode(stdout);
+        try {
+            return run_batch(std::cin, std::cout, batch_framing, format_document) == 0 ? 0 : 1;
+        } catch (const std::exception &e) {
+            fprintf(stderr, "%s: %s\n", argv[0], e.what());
+            exit(1);
+        }
+    }
+
+    if (git_filter_process) {
+        if (filenames.size() != 0 || format_in_place) {
+            fprintf(stderr, "%s: '-git-filter-process' takes no filenames. Try: %s -help\n",
+                argv[0], argv[0]);
+            exit(1);
+        }
+        set_binary_mode(stdin);
+        set_binary_mode(stdout);
+        try {
+            run_git_filter_process(std::cin, std::cout, [&](const std::string &content) {
+                std::string output;
+                format_document(content, output);
+                return output;
+            });
+        } catch (const std::exception &e) {
+            fprintf(stderr, "%s: %s\n", argv[0], e.what());
+            exit(1);
+        }
+        return 0;
+    }
+
+    if (output_replacements && format_in_place) {
+        fprintf(stderr, "%s: '-output-replacements' can't be used with '-i'. Try: %s -help\n",
+            argv[0], argv[0]);
+        exit(1);
+    }
+    // The replacements of each file are a document of their own, so there's no way to write
+    // those of several to one output.
+    if (output_replacements && filenames.size() > 1) {
+        fprintf(stderr,
+            "%s: '-output-replacements' can't be used with more than one file. Try: %s -help\n",
+            argv[0], argv[0]);
+        exit(1);
+    }
+    if (output_diff && (format_in_place || output_replacements)) {
+        fprintf(stderr,
+            "%s: '-diff' can't be used with '-i' or '-output-replacements'. Try: %s -help\n",
+            argv[0], argv[0]);
+        exit(1);
     }
 
     if (filenames.size() == 0) {
@@ -195,38 +439,203 @@ int main(int argc, char **argv) {
         filenames.emplace_back("-");
     }
 
+    if (stats) {
+        if (format_in_place || output_diff || output_replacements) {
+            fprintf(stderr,
+                "%s: '-stats' can't be used with '-i', '-diff' or '-output-replacements'. Try: "
+                "%s -help\n",
+                argv[0], argv[0]);
+            exit(1);
+        }
+        StatsReport stats_report;
+        size_t failures = 0;
+        for (const auto &filename : filenames) {
+            std::string content;
+            read_file(filename, content);
+            try {
+                const auto start = std::chrono::steady_clock::now();
+                parse(content, context.spans, context.parse_context);
+                const std::chrono::duration<double> parse_time =
+                    std::chrono::steady_clock::now() - start;
+                stats_report.add(
+                    filename, compute_stats(content, context.spans), parse_time.count());
+            } catch (const parseexception &e) {
+                fprintf(stderr, "%s: %s\n", filename.c_str(), e.what());
+                failures++;
+            }
+        }
+        stats_report.write(std::cout);
+        return failures == 0 ? 0 : 1;
+    }
+
+    if (alloc_report && !counting_allocations()) {
+        fprintf(stderr,
+            "%s: '-alloc-report' needs a build with CMAKEFORMAT_COUNT_ALLOCATIONS, which this "
+            "isn't\n",
+            argv[0]);
+        exit(1);
+    }
+
+    if (max_memory_megabytes != 0 && (output_diff || output_replacements)) {
+        fprintf(stderr,
+            "%s: '-max-memory' can't be used with '-diff' or '-output-replacements'. Try: %s "
+            "-help\n",
+            argv[0], argv[0]);
+        exit(1);
+    }
+    // Files bigger than this are formatted a piece at a time, in pieces about this big.
+    size_t chunk_size = 0;
+    if (max_memory_megabytes != 0) {
+        const size_t max_memory = max_memory_megabytes * 1024 * 1024;
+        const size_t used = resident_memory().current;
+        if (max_memory <= used) {
+            fprintf(stderr, "%s: '-max-memory=%zu' is less than is already in use (%zu MB)\n",
+                argv[0], max_memory_megabytes, used / (1024 * 1024));
+            exit(1);
+        }
+        chunk_size = std::max<size_t>((max_memory - used) / memory_per_input_byte, 64 * 1024);
+    }
+
+    TimeReport report;
+    AllocationReport allocations;
+    MemoryReport memory;
+    TraceRecorder trace;
+    PhaseObservers observers;
+    if (time_report) {
+        observers.observers.push_back(&report);
+    }
+    if (alloc_report) {
+        observers.observers.push_back(&allocations);
+    }
+    if (!trace_filename.empty()) {
+        observers.observers.push_back(&trace);
+    }
+    PhaseObserver *observer = nullptr;
+    if (!observers.observers.empty()) {
+        observer = &observers;
+        context.observer = observer;
+    }
+
+    std::vector<Replacement> replacements;
+    bool any_differences = false;
     for (auto filename : filenames) {
-        inputwrapper file_in;
-        if (filename != "-") {
-            file_in.open(filename);
-        };
-        std::string content;
-        { content = {std::istreambuf_iterator<char>(file_in), std::istreambuf_iterator<char>()}; }
+        if (time_report) {
+            report.begin_file(filename);
+        }
+        if (alloc_report) {
+            allocations.begin_file(filename);
+        }
+        if (memory_report) {
+            memory.begin_file(filename);
+        }
+        if (!trace_filename.empty()) {
+            trace.begin_file(filename);
+        }
 
-        std::vector<Span> spans = parse(content);
+        size_t size = 0;
+        size_t spans = 0;
+        size_t chunks = 0;
+        if (max_memory_megabytes != 0 && file_size(filename) > chunk_size) {
+            // Written next to the file, then moved over it, since it's still being read.
+            const std::string temporary_filename = filename + ".cmake-format.tmp";
+            const bool in_place = format_in_place && filename != "-";
+            {
+                inputwrapper file_in;
+                if (filename != "-") {
+                    file_in.open(filename);
+                }
+                outputwrapper file_out;
+                if (in_place) {
+                    file_out.open(temporary_filename);
+                }
+                StreamedChunks streamed;
+                try {
+                    streamed = format_stream(file_in, file_out, options, context, chunk_size);
+                } catch (const parseexception &e) {
+                    // What's been written so far would cut the file short.
+                    if (in_place) {
+                        file_out.file.close();
+                        std::remove(temporary_filename.c_str());
+                    }
+                    fprintf(stderr, "%s: %s: %s\n", argv[0], filename.c_str(), e.what());
+                    exit(1);
+                }
+                size = streamed.input_size;
+                spans = streamed.spans;
+                chunks = streamed.chunks;
+            }
+            if (in_place && !replace_file(temporary_filename, filename)) {
+                fprintf(stderr, "%s: can't replace '%s'\n", argv[0], filename.c_str());
+                exit(1);
+            }
+        } else {
+            std::string content;
+            {
+                ScopedPhase phase{observer, Phase::Read};
+                read_file(filename, content);
+            }
 
-        transform_indent(spans, repeat_string(" ", indent_width));
-        transform_loosen_loop_constructs(spans);
+            if (output_replacements) {
+                format_spans(content, options, context);
+                ScopedPhase phase{observer, Phase::Write};
+                compute_replacements(content, context.spans, replacements);
+                write_replacements(std::cout, replacements_format, replacements);
+            } else {
+                std::string output;
+                format_document(content, output);
 
-        if (reflow_arguments == ReflowArguments::BinPack) {
-            transform_argument_bin_pack(
-                spans, column_limit, repeat_string(" ", continuation_indent_width));
-        } else if (reflow_arguments == ReflowArguments::OnePerLine) {
-            transform_argument_per_line(spans, repeat_string(" ", continuation_indent_width));
-        } else if (reflow_arguments == ReflowArguments::Heuristic) {
-            transform_argument_heuristic(
-                spans, column_limit, repeat_string(" ", continuation_indent_width));
+                ScopedPhase phase{observer, Phase::Write};
+                if (output_diff) {
+                    if (write_unified_diff(std::cout, filename, content, output)) {
+                        any_differences = true;
+                    }
+                } else {
+                    outputwrapper file_out;
+                    if (format_in_place && filename != "-") {
+                        file_out.open(filename);
+                    }
+                    (std::ostream &)file_out << output;
+                }
+            }
+            size = content.size();
+            spans = context.spans.size();
         }
-        transform_command_case(spans, command_case);
-        transform_squash_empty_lines(spans, max_empty_lines_to_keep);
-        transform_space_before_parens(spans, space_before_parens);
 
-        outputwrapper file_out;
-        if (format_in_place && filename != "-") {
-            file_out.open(filename);
+        if (time_report) {
+            report.current_file().size = size;
+        }
+        if (alloc_report) {
+            allocations.current_file().size = size;
+            allocations.current_file().spans = spans;
         }
-        for (auto s : spans) {
-            (std::ostream &)file_out << s.data;
+        if (memory_report) {
+            memory.end_file(size, chunks);
+        }
+        if (!trace_filename.empty()) {
+            trace.end_file(size, spans);
+        }
+    }
+
+    if (time_report) {
+        std::cout.flush();
+        report.write(std::cerr);
+    }
+    if (alloc_report) {
+        std::cout.flush();
+        allocations.write(std::cerr);
+    }
+    if (memory_report) {
+        std::cout.flush();
+        memory.write(std::cerr);
+    }
+    if (!trace_filename.empty()) {
+        std::ofstream trace_file{trace_filename};
+        trace.write(trace_file);
+        if (!trace_file) {
+            fprintf(stderr, "%s: can't write trace to '%s'\n", argv[0], trace_filename.c_str());
+            exit(1);
         }
     }
+
+    return any_differences ? 1 : 0;
 }
@@ -0,0 +1,340 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <thread>
+
+#ifdef CMAKEFORMAT_BUILD_TESTS
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+#endif
+
+#include "allocations.h"
+#include "cmakeformat.h"
+#include "corpus.h"
+#include "helpers.h"
+#include "transform.h"
+
+const char *phase_name(Phase phase) {
+    switch (phase) {
+    case Phase::Read:
+        return "read";
+    case Phase::Parse:
+        return "parse";
+    case Phase::TransformIndent:
+        return "transform_indent";
+    case Phase::TransformLoosenLoopConstructs:
+        return "transform_loosen_loop_constructs";
+    case Phase::TransformArgumentBinPack:
+        return "transform_argument_bin_pack";
+    case Phase::TransformArgumentPerLine:
+        return "transform_argument_per_line";
+    case Phase::TransformArgumentHeuristic:
+        return "transform_argument_heuristic";
+    case Phase::TransformArgumentBinPackBalanced:
+        return "transform_argument_bin_pack_balanced";
+    case Phase::TransformCommandCase:
+        return "transform_command_case";
+    case Phase::TransformSquashEmptyLines:
+        return "transform_squash_empty_lines";
+    case Phase::TransformSpaceBeforeParens:
+        return "transform_space_before_parens";
+    case Phase::Join:
+        return "join";
+    case Phase::Write:
+        return "write";
+    }
+    return "";
+}
+
+SpanRewriterScratch &span_rewriter_scratch() {
+    thread_local SpanRewriterScratch scratch;
+    return scratch;
+}
+
+void format_spans(const std::string &input, const FormatOptions &options, FormatContext &context) {
+    {
+        ScopedPhase phase{context.observer, Phase::Parse};
+        parse(input, context.spans, context.parse_context);
+    }
+    transform_spans(options, context);
+}
+
+void transform_spans(const FormatOptions &options, FormatContext &context) {
+    const size_t continuation_indent_width = options.continuation_indent_width == 0
+                                                 ? options.indent_width
+                                                 : options.continuation_indent_width;
+    if (context.indent_string.size() != options.indent_width) {
+        context.indent_string = repeat_string(" ", options.indent_width);
+    }
+    if (context.continuation_indent_string.size() != continuation_indent_width) {
+        context.continuation_indent_string = repeat_string(" ", continuation_indent_width);
+    }
+
+    std::vector<Span> &spans = context.spans;
+    PhaseObserver *observer = context.observer;
+    {
+        ScopedPhase phase{observer, Phase::TransformIndent};
+        transform_indent(spans, context.indent_string);
+    }
+    {
+        ScopedPhase phase{observer, Phase::TransformLoosenLoopConstructs};
+        transform_loosen_loop_constructs(spans);
+    }
+
+    if (options.reflow_arguments == ReflowArguments::BinPack) {
+        ScopedPhase phase{observer, Phase::TransformArgumentBinPack};
+        transform_argument_bin_pack(
+            spans, options.column_limit, context.continuation_indent_string);
+    } else if (options.reflow_arguments == ReflowArguments::OnePerLine) {
+        ScopedPhase phase{observer, Phase::TransformArgumentPerLine};
+        transform_argument_per_line(spans, context.continuation_indent_string);
+    } else if (options.reflow_arguments == ReflowArguments::Heuristic) {
+        ScopedPhase phase{observer, Phase::TransformArgumentHeuristic};
+        transform_argument_heuristic(spans, options.column_limit,
+            context.continuation_indent_string,
+            options.command_signatures ? *options.command_signatures
+                                       : builtin_command_signatures());
+    } else if (options.reflow_arguments == ReflowArguments::BinPackBalanced) {
+        ScopedPhase phase{observer, Phase::TransformArgumentBinPackBalanced};
+        transform_argument_bin_pack_balanced(
+            spans, options.column_limit, context.continuation_indent_string);
+    }
+    {
+        ScopedPhase phase{observer, Phase::TransformCommandCase};
+        transform_command_case(spans, options.command_case);
+    }
+    {
+        ScopedPhase phase{observer, Phase::TransformSquashEmptyLines};
+        transform_squash_empty_lines(spans, options.max_empty_lines_to_keep);
+    }
+    {
+        ScopedPhase phase{observer, Phase::TransformSpaceBeforeParens};
+        transform_space_before_parens(spans, options.space_before_parens);
+    }
+}
+
+void format(const std::string &input, const FormatOptions &options, std::string &output,
+    FormatContext &context) {
+    format_spans(input, options, context);
+    ScopedPhase phase{context.observer, Phase::Join};
+    output.clear();
+    for (const auto &s : context.spans) {
+        output += s.data;
+    }
+}
+
+std::string format(const std::string &input, const FormatOptions &options) {
+    FormatContext context;
+    std::string output;
+    format(input, options, output, context);
+    return output;
+}
+
+StreamedChunks format_stream(std::istream &input, std::ostream &output,
+    const FormatOptions &options, FormatContext &context, size_t chunk_size) {
+    const size_t block_size = 64 * 1024;
+    StreamedChunks streamed;
+    std::string pending;
+    std::string chunk;
+    std::string formatted;
+    // Grows while there's nowhere to cut, so that looking for somewhere stays linear.
+    size_t wanted = chunk_size;
+    bool at_end = false;
+    while (true) {
+        {
+            ScopedPhase phase{context.observer, Phase::Read};
+            while (!at_end && pending.size() < wanted) {
+                const size_t size = pending.size();
+                const size_t block = std::min(block_size, wanted - size);
+                pending.resize(size + block);
+                input.read(&pending[size], block);
+                pending.resize(size + static_cast<size_t>(input.gcount()));
+                at_end = !input;
+            }
+        }
+        if (pending.empty()) {
+            break;
+        }
+
+        size_t split = pending.size();
+        if (!at_end) {
+            ScopedPhase phase{context.observer, Phase::Parse};
+            split = find_last_split(pending, context.parse_context);
+            if (split == 0) {
+                wanted = pending.size() * 2;
+                continue;
+            }
+        }
+        chunk.assign(pending, 0, split);
+        pending.erase(0, split);
+        wanted = chunk_size;
+
+        format(chunk, options, formatted, context);
+        streamed.input_size += chunk.size();
+        streamed.chunks++;
+        streamed.largest_chunk = std::max(streamed.largest_chunk, chunk.size());
+        streamed.spans += context.spans.size();
+        ScopedPhase phase{context.observer, Phase::Write};
+        output << formatted;
+    }
+    return streamed;
+}
+
+#ifdef CMAKEFORMAT_BUILD_TESTS
+int run_self_test(int argc, char **argv) {
+    doctest::Context context;
+    context.applyCommandLine(argc, argv);
+    return context.run();
+}
+#endif
+
+TEST_CASE("Formats with the default options") {
+    REQUIRE(format("IF(A)\ncommand(ARG)\n\n\nENDIF(A)\n", FormatOptions{}) ==
+            "if(A)\n    command(ARG)\n\nendif()\n");
+}
+
+TEST_CASE("Reuses a format context") {
+    FormatOptions options;
+    options.indent_width = 2;
+    options.reflow_arguments = ReflowArguments::OnePerLine;
+    FormatContext context;
+    std::string output;
+    format("if(A)\ncommand(ARG)\nendif()\n", options, output, context);
+    REQUIRE(output == "if(\n  A\n)\n  command(\n    ARG\n  )\nendif(\n)\n");
+    options.indent_width = 3;
+    options.continuation_indent_width = 1;
+    format("if(A)\ncommand(ARG)\nendif()\n", options, output, context);
+    REQUIRE(output == "if(\n A\n)\n   command(\n    ARG\n   )\nendif(\n)\n");
+}
+
+TEST_CASE("Tells an observer about each phase") {
+    struct Recorder : PhaseObserver {
+        void begin_phase(Phase phase) override {
+            events.push_back(std::string{"+"} + phase_name(phase));
+        }
+        void end_phase(Phase phase) override {
+            events.push_back(std::string{"-"} + phase_name(phase));
+        }
+        std::vector<std::string> events;
+    } recorder;
+
+    FormatOptions options;
+    options.reflow_arguments = ReflowArguments::BinPack;
+    FormatContext context;
+    context.observer = &recorder;
+    std::string output;
+    format("command(ARG)\n", options, output, context);
+
+    const std::vector<std::string> wanted{"+parse", "-parse", "+transform_indent",
+        "-transform_indent", "+transform_loosen_loop_constructs",
+        "-transform_loosen_loop_constructs", "+transform_argument_bin_pack",
+        "-transform_argument_bin_pack", "+transform_command_case", "-transform_command_case",
+        "+transform_squash_empty_lines", "-transform_squash_empty_lines",
+        "+transform_space_before_parens", "-transform_space_before_parens", "+join", "-join"};
+    REQUIRE(recorder.events == wanted);
+}
+
+TEST_CASE("Reformats parsed spans without allocating") {
+    if (!counting_allocations()) {
+        return;
+    }
+    // Deep enough, and with names long enough, that the strings involved don't fit inline.
+    const std::string input = R"(
+IF(A)
+  if(B)
+    if(C)
+      if(D)
+        TARGET_LINK_LIBRARIES(a_target_with_a_long_name PUBLIC first_library # comment
+          second_library ${THIRD_LIBRARY} "a quoted argument" COMMAND do something
+          $<$<CONFIG:Debug>:debug_library>)
+        message(STATUS "done")  
+
+
+      else()
+        add_custom_command_with_a_long_name(OUTPUT x)
+      endif(D)
+    endif()
+  endif()
+endif()
+)";
+    const ReflowArguments algorithms[] = {ReflowArguments::None, ReflowArguments::OnePerLine,
+        ReflowArguments::BinPack, ReflowArguments::Heuristic, ReflowArguments::BinPackBalanced};
+    for (ReflowArguments algorithm : algorithms) {
+        FormatOptions options;
+        options.reflow_arguments = algorithm;
+        options.column_limit = 40;
+        options.command_case = LetterCase::Upper;
+        options.space_before_parens = SpaceBeforeParens::ControlStatements;
+        FormatContext context;
+        format_spans(input, options, context);
+        transform_spans(options, context);
+
+        const AllocationCounts before = thread_allocations();
+        transform_spans(options, context);
+        const AllocationCounts after = thread_allocations();
+        REQUIRE(after.allocations == before.allocations);
+    }
+}
+
+TEST_CASE("Formats on several threads at once") {
+    std::string input;
+    for (int i = 0; i < 200; i++) {
+        input += "IF(A)\ncommand(ARG1 ARG2 ARG3 ARG4 ARG5 ARG6 ARG7 ARG8 ARG9 ARG10 ARG11)\n";
+        input += "ENDIF()\n";
+    }
+    FormatOptions options;
+    options.reflow_arguments = ReflowArguments::BinPack;
+    options.column_limit = 40;
+    const std::string wanted = format(input, options);
+
+    std::vector<std::string> outputs(4);
+    std::vector<std::thread> threads;
+    for (auto &output : outputs) {
+        threads.emplace_back([&] {
+            FormatContext context;
+            for (int i = 0; i < 10; i++) {
+                format(input, options, output, context);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    for (const auto &output : outputs) {
+        REQUIRE(output == wanted);
+    }
+}
+
+TEST_CASE("Formats a stream a piece at a time") {
+    CorpusOptions corpus_options;
+    corpus_options.size = 64 * 1024;
+    const std::string input = generate_corpus(corpus_options) + "if(A)\n" +
+                              repeat_string("  command(ARGUMENT)\n", 10000) + "endif()\n";
+    const ReflowArguments algorithms[] = {ReflowArguments::None, ReflowArguments::OnePerLine,
+        ReflowArguments::BinPack, ReflowArguments::Heuristic, ReflowArguments::BinPackBalanced};
+    for (ReflowArguments algorithm : algorithms) {
+        FormatOptions options;
+        options.reflow_arguments = algorithm;
+        options.column_limit = 40;
+        FormatContext context;
+        std::istringstream in{input};
+        std::ostringstream out;
+        const StreamedChunks streamed = format_stream(in, out, options, context, 1024);
+        REQUIRE(out.str() == format(input, options));
+        REQUIRE(streamed.input_size == input.size());
+        REQUIRE(streamed.chunks > 10);
+        // The if() block can't be cut up.
+        REQUIRE(streamed.largest_chunk > 20 * 10000);
+    }
+
+    FormatContext context;
+    std::istringstream empty{""};
+    std::ostringstream out;
+    REQUIRE(format_stream(empty, out, FormatOptions{}, context, 1024).chunks == 0);
+    REQUIRE(out.str() == "");
+}
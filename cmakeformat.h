@@ -0,0 +1,144 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "parser.h"
+#include "signatures.h"
+
+enum class SpaceBeforeParens {
+    Never,
+    ControlStatements,
+    Always,
+};
+
+enum class LetterCase {
+    Lower,
+    Upper,
+};
+
+enum class ReflowArguments {
+    None,
+    OnePerLine,
+    BinPack,
+    Heuristic,
+    // Like BinPack, but breaking lines to leave them about even rather than filling each in turn.
+    BinPackBalanced,
+};
+
+// The steps of formatting one document, in the order they run. Read and Write are up to the
+// caller; format() only runs Parse through Join.
+enum class Phase {
+    Read,
+    Parse,
+    TransformIndent,
+    TransformLoosenLoopConstructs,
+    TransformArgumentBinPack,
+    TransformArgumentPerLine,
+    TransformArgumentHeuristic,
+    TransformArgumentBinPackBalanced,
+    TransformCommandCase,
+    TransformSquashEmptyLines,
+    TransformSpaceBeforeParens,
+    // Concatenating the spans into the output string.
+    Join,
+    Write,
+};
+constexpr size_t phase_count = static_cast<size_t>(Phase::Write) + 1;
+
+const char *phase_name(Phase phase);
+
+// Told when each phase of formatting starts and finishes, for profiling.
+struct PhaseObserver {
+    virtual ~PhaseObserver() {
+    }
+    virtual void begin_phase(Phase phase) = 0;
+    virtual void end_phase(Phase phase) = 0;
+};
+
+// Tells observer (if not null) about a phase that lasts as long as this object.
+struct ScopedPhase {
+    ScopedPhase(PhaseObserver *observer_, Phase phase_) : observer{observer_}, phase{phase_} {
+        if (observer) {
+            observer->begin_phase(phase);
+        }
+    }
+    ~ScopedPhase() {
+        if (observer) {
+            observer->end_phase(phase);
+        }
+    }
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+    PhaseObserver *observer;
+    Phase phase;
+};
+
+struct FormatOptions {
+    // Maximum column width. If reflow_arguments is None, this does nothing.
+    size_t column_limit = 80;
+    LetterCase command_case = LetterCase::Lower;
+    // Indent width for line continuations; 0 means the same as indent_width.
+    size_t continuation_indent_width = 0;
+    size_t indent_width = 4;
+    size_t max_empty_lines_to_keep = 1;
+    ReflowArguments reflow_arguments = ReflowArguments::None;
+    SpaceBeforeParens space_before_parens = SpaceBeforeParens::Never;
+    // The signatures the heuristic reflow groups arguments by. Not owned; null means the
+    // built-in ones.
+    const CommandSignatures *command_signatures = nullptr;
+};
+
+// Scratch space for formatting. Reusing one across calls to format() saves reallocating the
+// lexer and the span storage for every input. A context must only be used by one thread at a
+// time; separate contexts can be used concurrently.
+struct FormatContext {
+    ParseContext parse_context;
+    std::vector<Span> spans;
+    std::string indent_string;
+    std::string continuation_indent_string;
+    // Not owned; null unless profiling.
+    PhaseObserver *observer = nullptr;
+};
+
+// Parses and transforms input, leaving the formatted spans in context.spans. Throws
+// parseexception if input isn't valid CMake.
+void format_spans(const std::string &input, const FormatOptions &options, FormatContext &context);
+
+// Runs every transform over context.spans in place, as format_spans() does after parsing. Once
+// it has transformed as many spans before, on the same thread, this doesn't allocate.
+void transform_spans(const FormatOptions &options, FormatContext &context);
+
+// Formats input into output, replacing the contents of output but reusing its storage.
+void format(const std::string &input, const FormatOptions &options, std::string &output,
+    FormatContext &context);
+
+std::string format(const std::string &input, const FormatOptions &options);
+
+// How format_stream() split up its input.
+struct StreamedChunks {
+    size_t input_size = 0;
+    size_t chunks = 0;
+    size_t largest_chunk = 0;
+    // Over all the chunks.
+    size_t spans = 0;
+};
+
+// Formats input to output a piece at a time, cutting it where find_last_split() says that
+// formatting the pieces separately gives the same result as formatting it all at once. Pieces
+// are about chunk_size bytes, or bigger where there's nowhere to cut, so memory use depends on
+// chunk_size rather than on the size of input. Throws parseexception if input isn't valid CMake,
+// after writing out the pieces before the invalid one.
+StreamedChunks format_stream(std::istream &input, std::ostream &output,
+    const FormatOptions &options, FormatContext &context, size_t chunk_size);
+
+#ifdef CMAKEFORMAT_BUILD_TESTS
+// Runs the built-in test suite; argv is passed to the test runner.
+int run_self_test(int argc, char **argv);
+#endif
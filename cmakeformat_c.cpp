@@ -0,0 +1,196 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <cstring>
+#include <new>
+#include <string>
+
+#include "cmakeformat.h"
+#include "cmakeformat_c.h"
+
+struct cmakeformat_options {
+    FormatOptions options;
+};
+
+struct cmakeformat_context {
+    FormatOptions options;
+    FormatContext format_context;
+    // Kept between calls so that formatting many buffers doesn't reallocate them.
+    std::string input;
+    std::string output;
+    std::string error;
+};
+
+cmakeformat_options *cmakeformat_options_new(void) {
+    return new (std::nothrow) cmakeformat_options;
+}
+
+void cmakeformat_options_delete(cmakeformat_options *options) {
+    delete options;
+}
+
+cmakeformat_status cmakeformat_options_set_column_limit(
+    cmakeformat_options *options, size_t column_limit) {
+    if (!options) {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    options->options.column_limit = column_limit;
+    return CMAKEFORMAT_OK;
+}
+
+cmakeformat_status cmakeformat_options_set_command_case(
+    cmakeformat_options *options, cmakeformat_letter_case command_case) {
+    if (!options) {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    if (command_case == CMAKEFORMAT_LETTER_CASE_LOWER) {
+        options->options.command_case = LetterCase::Lower;
+    } else if (command_case == CMAKEFORMAT_LETTER_CASE_UPPER) {
+        options->options.command_case = LetterCase::Upper;
+    } else {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    return CMAKEFORMAT_OK;
+}
+
+cmakeformat_status cmakeformat_options_set_continuation_indent_width(
+    cmakeformat_options *options, size_t continuation_indent_width) {
+    if (!options) {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    options->options.continuation_indent_width = continuation_indent_width;
+    return CMAKEFORMAT_OK;
+}
+
+cmakeformat_status cmakeformat_options_set_indent_width(
+    cmakeformat_options *options, size_t indent_width) {
+    if (!options) {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    options->options.indent_width = indent_width;
+    return CMAKEFORMAT_OK;
+}
+
+cmakeformat_status cmakeformat_options_set_max_empty_lines_to_keep(
+    cmakeformat_options *options, size_t max_empty_lines_to_keep) {
+    if (!options) {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    options->options.max_empty_lines_to_keep = max_empty_lines_to_keep;
+    return CMAKEFORMAT_OK;
+}
+
+cmakeformat_status cmakeformat_options_set_reflow_arguments(
+    cmakeformat_options *options, cmakeformat_reflow_arguments reflow_arguments) {
+    if (!options) {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    if (reflow_arguments == CMAKEFORMAT_REFLOW_ARGUMENTS_NONE) {
+        options->options.reflow_arguments = ReflowArguments::None;
+    } else if (reflow_arguments == CMAKEFORMAT_REFLOW_ARGUMENTS_ONE_PER_LINE) {
+        options->options.reflow_arguments = ReflowArguments::OnePerLine;
+    } else if (reflow_arguments == CMAKEFORMAT_REFLOW_ARGUMENTS_BIN_PACK) {
+        options->options.reflow_arguments = ReflowArguments::BinPack;
+    } else if (reflow_arguments == CMAKEFORMAT_REFLOW_ARGUMENTS_HEURISTIC) {
+        options->options.reflow_arguments = ReflowArguments::Heuristic;
+    } else if (reflow_arguments == CMAKEFORMAT_REFLOW_ARGUMENTS_BIN_PACK_BALANCED) {
+        options->options.reflow_arguments = ReflowArguments::BinPackBalanced;
+    } else {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    return CMAKEFORMAT_OK;
+}
+
+cmakeformat_status cmakeformat_options_set_space_before_parens(
+    cmakeformat_options *options, cmakeformat_space_before_parens space_before_parens) {
+    if (!options) {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    if (space_before_parens == CMAKEFORMAT_SPACE_BEFORE_PARENS_NEVER) {
+        options->options.space_before_parens = SpaceBeforeParens::Never;
+    } else if (space_before_parens == CMAKEFORMAT_SPACE_BEFORE_PARENS_CONTROL_STATEMENTS) {
+        options->options.space_before_parens = SpaceBeforeParens::ControlStatements;
+    } else if (space_before_parens == CMAKEFORMAT_SPACE_BEFORE_PARENS_ALWAYS) {
+        options->options.space_before_parens = SpaceBeforeParens::Always;
+    } else {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    return CMAKEFORMAT_OK;
+}
+
+cmakeformat_context *cmakeformat_context_new(const cmakeformat_options *options) {
+    if (!options) {
+        return nullptr;
+    }
+    try {
+        cmakeformat_context *context = new cmakeformat_context;
+        context->options = options->options;
+        return context;
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+}
+
+void cmakeformat_context_delete(cmakeformat_context *context) {
+    delete context;
+}
+
+const char *cmakeformat_context_error(const cmakeformat_context *context) {
+    if (!context) {
+        return "";
+    }
+    return context->error.c_str();
+}
+
+static cmakeformat_status set_error(
+    cmakeformat_context *context, cmakeformat_status status, const char *message) {
+    try {
+        context->error = message;
+    } catch (const std::bad_alloc &) {
+        context->error.clear();
+    }
+    return status;
+}
+
+cmakeformat_status cmakeformat_format(cmakeformat_context *context, const char *input,
+    size_t input_size, cmakeformat_buffer *output) {
+    if (!context) {
+        return CMAKEFORMAT_ERROR_INVALID_ARGUMENT;
+    }
+    context->error.clear();
+    if ((!input && input_size != 0) || !output) {
+        return set_error(context, CMAKEFORMAT_ERROR_INVALID_ARGUMENT, "null input or output");
+    }
+    if (input_size != 0 && std::memchr(input, '\0', input_size)) {
+        return set_error(context, CMAKEFORMAT_ERROR_INVALID_ARGUMENT, "input contains NUL");
+    }
+
+    try {
+        context->input.assign(input, input_size);
+        format(context->input, context->options, context->output, context->format_context);
+    } catch (const parseexception &e) {
+        return set_error(context, CMAKEFORMAT_ERROR_PARSE, e.what());
+    } catch (const std::bad_alloc &) {
+        return set_error(context, CMAKEFORMAT_ERROR_OUT_OF_MEMORY, "out of memory");
+    } catch (const std::exception &e) {
+        return set_error(context, CMAKEFORMAT_ERROR_INTERNAL, e.what());
+    }
+
+    const size_t size = context->output.size();
+    if (!output->data) {
+        output->data = &context->output[0];
+        output->size = size;
+        // The context's storage isn't the caller's to write to, so a call that reuses output
+        // without setting data back to NULL reports the buffer too small rather than copying
+        // into it.
+        output->capacity = 0;
+        return CMAKEFORMAT_OK;
+    }
+    output->size = size;
+    if (size > output->capacity) {
+        return set_error(context, CMAKEFORMAT_ERROR_BUFFER_TOO_SMALL, "output buffer too small");
+    }
+    std::memcpy(output->data, context->output.data(), size);
+    return CMAKEFORMAT_OK;
+}
@@ -0,0 +1,112 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+/* C interface to the formatter, for hosts that can't use the C++ API in cmakeformat.h, such as
+   Python's ctypes or Node's ffi. Nothing here throws; every fallible call returns a status. */
+
+#ifndef CMAKEFORMAT_C_H
+#define CMAKEFORMAT_C_H
+
+#include <stddef.h>
+
+#if defined(_WIN32) && defined(CMAKEFORMAT_C_BUILDING)
+#define CMAKEFORMAT_C_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define CMAKEFORMAT_C_API __declspec(dllimport)
+#elif defined(__GNUC__)
+#define CMAKEFORMAT_C_API __attribute__((visibility("default")))
+#else
+#define CMAKEFORMAT_C_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum cmakeformat_status {
+    CMAKEFORMAT_OK = 0,
+    /* The input isn't valid CMake; see cmakeformat_context_error(). */
+    CMAKEFORMAT_ERROR_PARSE = 1,
+    /* The caller's buffer is too small; its size has been set to the size needed. */
+    CMAKEFORMAT_ERROR_BUFFER_TOO_SMALL = 2,
+    CMAKEFORMAT_ERROR_INVALID_ARGUMENT = 3,
+    CMAKEFORMAT_ERROR_OUT_OF_MEMORY = 4,
+    CMAKEFORMAT_ERROR_INTERNAL = 5
+} cmakeformat_status;
+
+typedef enum cmakeformat_letter_case {
+    CMAKEFORMAT_LETTER_CASE_LOWER = 0,
+    CMAKEFORMAT_LETTER_CASE_UPPER = 1
+} cmakeformat_letter_case;
+
+typedef enum cmakeformat_reflow_arguments {
+    CMAKEFORMAT_REFLOW_ARGUMENTS_NONE = 0,
+    CMAKEFORMAT_REFLOW_ARGUMENTS_ONE_PER_LINE = 1,
+    CMAKEFORMAT_REFLOW_ARGUMENTS_BIN_PACK = 2,
+    CMAKEFORMAT_REFLOW_ARGUMENTS_HEURISTIC = 3,
+    CMAKEFORMAT_REFLOW_ARGUMENTS_BIN_PACK_BALANCED = 4
+} cmakeformat_reflow_arguments;
+
+typedef enum cmakeformat_space_before_parens {
+    CMAKEFORMAT_SPACE_BEFORE_PARENS_NEVER = 0,
+    CMAKEFORMAT_SPACE_BEFORE_PARENS_CONTROL_STATEMENTS = 1,
+    CMAKEFORMAT_SPACE_BEFORE_PARENS_ALWAYS = 2
+} cmakeformat_space_before_parens;
+
+/* Formatting options, initialized to the same defaults as the cmake-format executable. */
+typedef struct cmakeformat_options cmakeformat_options;
+
+CMAKEFORMAT_C_API cmakeformat_options *cmakeformat_options_new(void);
+CMAKEFORMAT_C_API void cmakeformat_options_delete(cmakeformat_options *options);
+
+CMAKEFORMAT_C_API cmakeformat_status cmakeformat_options_set_column_limit(
+    cmakeformat_options *options, size_t column_limit);
+CMAKEFORMAT_C_API cmakeformat_status cmakeformat_options_set_command_case(
+    cmakeformat_options *options, cmakeformat_letter_case command_case);
+/* 0 means the same as the indent width. */
+CMAKEFORMAT_C_API cmakeformat_status cmakeformat_options_set_continuation_indent_width(
+    cmakeformat_options *options, size_t continuation_indent_width);
+CMAKEFORMAT_C_API cmakeformat_status cmakeformat_options_set_indent_width(
+    cmakeformat_options *options, size_t indent_width);
+CMAKEFORMAT_C_API cmakeformat_status cmakeformat_options_set_max_empty_lines_to_keep(
+    cmakeformat_options *options, size_t max_empty_lines_to_keep);
+CMAKEFORMAT_C_API cmakeformat_status cmakeformat_options_set_reflow_arguments(
+    cmakeformat_options *options, cmakeformat_reflow_arguments reflow_arguments);
+CMAKEFORMAT_C_API cmakeformat_status cmakeformat_options_set_space_before_parens(
+    cmakeformat_options *options, cmakeformat_space_before_parens space_before_parens);
+
+/* A formatter with its own copy of the options and its own scratch space, which is reused by
+   every call to cmakeformat_format(). A context must only be used by one thread at a time;
+   separate contexts can be used concurrently. */
+typedef struct cmakeformat_context cmakeformat_context;
+
+/* Returns NULL if out of memory. */
+CMAKEFORMAT_C_API cmakeformat_context *cmakeformat_context_new(const cmakeformat_options *options);
+CMAKEFORMAT_C_API void cmakeformat_context_delete(cmakeformat_context *context);
+
+/* Describes the last error returned for this context, or is empty. Valid until the next call
+   that takes the context. */
+CMAKEFORMAT_C_API const char *cmakeformat_context_error(const cmakeformat_context *context);
+
+/* Where cmakeformat_format() puts its result. If data is NULL, it is pointed at storage owned
+   by the context, which stays valid until the next call that takes the context, and capacity is
+   set to 0, since it isn't the caller's to write to. Otherwise the result is copied into data if
+   it fits in capacity bytes. Either way size is set to the size of the result, which is not
+   NUL-terminated. To keep using the context's storage, set data back to NULL before each call;
+   passing the buffer back as it was fails with CMAKEFORMAT_ERROR_BUFFER_TOO_SMALL. */
+typedef struct cmakeformat_buffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+} cmakeformat_buffer;
+
+/* Formats input_size bytes of input. The input must not contain NUL bytes. */
+CMAKEFORMAT_C_API cmakeformat_status cmakeformat_format(cmakeformat_context *context,
+    const char *input, size_t input_size, cmakeformat_buffer *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -25,7 +25,7 @@ struct opterror_t {
 };
 constexpr opterror_t opterror;
 
-static std::function<void(const std::string &)> parse_numeric_option(size_t &ref) {
+inline std::function<void(const std::string &)> parse_numeric_option(size_t &ref) {
     return [&](const std::string &value) {
         try {
             ref = std::stoi(value);
@@ -40,7 +40,11 @@ static std::vector<std::string> parse_command_line(int argc, char **argv,
     const std::vector<ArgumentOptionDescription> &argument_options) {
     std::vector<std::string> positional_args;
     for (int i = 1; i < argc; i++) {
-        const std::string arg{argv[i]};
+        std::string arg{argv[i]};
+        // Accept GNU-style "--option" spellings too.
+        if (arg.size() > 2 && arg[0] == '-' && arg[1] == '-') {
+            arg.erase(0, 1);
+        }
 
         if ("-h" == arg || "-help" == arg || "--help" == arg) {
             fprintf(stderr, "usage: %s [options] [file ...]\n", argv[0]);
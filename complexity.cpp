@@ -0,0 +1,292 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// Checks that parse(), each transform and the whole pipeline scale no worse than n log n, by
+// timing them on inputs that double in size along several axes and fitting the growth rate.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "cmakeformat.h"
+#include "command_line.h"
+#include "corpus.h"
+#include "helpers.h"
+#include "transform.h"
+
+// A way of making inputs bigger.
+struct Axis {
+    const char *name;
+    std::function<std::string(size_t size)> make_input;
+};
+
+static std::string repeat_until(const std::string &prefix, const std::string &unit,
+    const std::string &suffix, size_t size) {
+    std::string content = prefix;
+    content.reserve(size + unit.size() + suffix.size());
+    while (content.size() + suffix.size() < size) {
+        content += unit;
+    }
+    return content + suffix;
+}
+
+static const std::vector<Axis> &axes() {
+    static const std::vector<Axis> axes = {
+        {"file length",
+            [](size_t size) {
+                CorpusOptions options;
+                options.size = size;
+                return generate_corpus(options);
+            }},
+        {"arguments per command",
+            [](size_t size) {
+                return repeat_until("add_library(target STATIC\n", " src/source_file.cpp",
+                    ")\n", size);
+            }},
+        {"comment run length",
+            [](size_t size) {
+                return repeat_until("if(A)\n", "    # a long run of comment lines\n",
+                    "    command(ARG)\nendif()\n", size);
+            }},
+        {"blank line run length",
+            [](size_t size) {
+                return repeat_until("command(ARG)\n", "\n", "command(ARG)\n", size);
+            }},
+        {"nesting depth",
+            [](size_t size) {
+                // Every line is indented by its depth, so the output is about 4 * depth * depth
+                // bytes; grow the depth so that the output grows like the other axes.
+                const size_t depth = static_cast<size_t>(std::sqrt(size / 4.0));
+                return repeat_string("if(A)\n", depth) + "command(ARG)\n" +
+                       repeat_string("endif()\n", depth);
+            }},
+    };
+    return axes;
+}
+
+struct Measurement {
+    size_t size;
+    double seconds;
+    // Time to copy the spans the benchmark starts from, and the output: linear work over the
+    // same memory.
+    double reference_seconds;
+};
+
+// Fits log(seconds / reference_seconds) = slope * log(size) + c by least squares, and returns
+// 1 + slope: about 1 for linear and n log n, 2 for quadratic. Dividing by a linear reference
+// cancels out the slowdown every pass over the spans sees once they outgrow the caches, which
+// would otherwise make linear transforms look superlinear at these sizes.
+static double growth_exponent(const std::vector<Measurement> &measurements) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (const auto &m : measurements) {
+        const double x = std::log(static_cast<double>(m.size));
+        const double y = std::log(m.seconds / m.reference_seconds);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    const double n = static_cast<double>(measurements.size());
+    return 1 + (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+// The fastest of a few runs of body, after setup, which isn't timed.
+static double time_best_of(
+    size_t runs, const std::function<void()> &setup, const std::function<void()> &body) {
+    using clock = std::chrono::steady_clock;
+    double best = 0;
+    for (size_t i = 0; i < runs; i++) {
+        setup();
+        const auto start = clock::now();
+        body();
+        const std::chrono::duration<double> elapsed = clock::now() - start;
+        best = i == 0 ? elapsed.count() : std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    size_t min_size = 1024;
+    size_t max_size = 4 * 1024 * 1024;
+    size_t max_exponent_percent = 130;
+    size_t max_milliseconds = 5000;
+    bool verbose = false;
+    std::string filter;
+
+    const static std::string description =
+        "Times parse(), each transform and the whole pipeline on inputs that double in size,\n"
+        "along several axes, and fails if any grows faster than about n log n. Size is\n"
+        "measured as input plus output bytes, since deep nesting makes output outgrow input.";
+    static std::vector<SwitchOptionDescription> switch_options = {
+        {"-v", "Print every measurement.", verbose},
+    };
+    const static std::vector<ArgumentOptionDescription> argument_options = {
+        {"-filter", "TEXT", "Only check benchmarks or axes whose name contains TEXT.",
+            [&](const std::string &value) { filter = value; }},
+        {"-max-exponent", "PERCENT",
+            "Fail if time grows faster than size to the power PERCENT/100.",
+            parse_numeric_option(max_exponent_percent)},
+        {"-max-size", "BYTES", "Largest input; sizes double from -min-size up to this.",
+            parse_numeric_option(max_size)},
+        {"-max-time", "MILLISECONDS",
+            "Stop growing an axis once one run of a benchmark takes this long.",
+            parse_numeric_option(max_milliseconds)},
+        {"-min-size", "BYTES", "Smallest input.", parse_numeric_option(min_size)},
+    };
+    parse_command_line(argc, argv, description, switch_options, argument_options);
+
+    // Times under this are mostly noise, and aren't used for fitting.
+    const double min_fit_seconds = 0.002;
+    const double max_seconds = max_milliseconds / 1000.0;
+    const double max_exponent = max_exponent_percent / 100.0;
+    const std::string indent_string = "    ";
+    const size_t column_limit = 80;
+
+    struct Benchmark {
+        const char *name;
+        // Which point in the pipeline it starts from, as in format_spans(): 0 is the input text,
+        // 1 is just parsed, 2 is indented, 3 is loosened and 4 is reflowed.
+        int stage;
+        std::function<void(std::vector<Span> &)> run;
+    };
+    std::string input;
+    std::string output;
+    FormatOptions options;
+    options.reflow_arguments = ReflowArguments::BinPack;
+    options.column_limit = column_limit;
+    FormatContext context;
+    ParseContext parse_context;
+    const std::vector<Benchmark> benchmarks = {
+        {"parse", 0, [&](std::vector<Span> &s) { parse(input, s, parse_context); }},
+        {"format", 0, [&](std::vector<Span> &) { format(input, options, output, context); }},
+        {"transform_indent", 1, [&](std::vector<Span> &s) { transform_indent(s, indent_string); }},
+        {"transform_indent_rparen", 2,
+            [&](std::vector<Span> &s) { transform_indent_rparen(s, indent_string); }},
+        {"transform_loosen_loop_constructs", 2,
+            [&](std::vector<Span> &s) { transform_loosen_loop_constructs(s); }},
+        {"transform_argument_bin_pack", 3,
+            [&](std::vector<Span> &s) {
+                transform_argument_bin_pack(s, column_limit, indent_string);
+            }},
+        {"transform_argument_bin_pack_balanced", 3,
+            [&](std::vector<Span> &s) {
+                transform_argument_bin_pack_balanced(s, column_limit, indent_string);
+            }},
+        {"transform_argument_per_line", 3,
+            [&](std::vector<Span> &s) { transform_argument_per_line(s, indent_string); }},
+        {"transform_argument_heuristic", 3,
+            [&](std::vector<Span> &s) {
+                transform_argument_heuristic(
+                    s, column_limit, indent_string, builtin_command_signatures());
+            }},
+        {"transform_command_case", 4,
+            [&](std::vector<Span> &s) { transform_command_case(s, LetterCase::Lower); }},
+        {"transform_squash_empty_lines", 4,
+            [&](std::vector<Span> &s) { transform_squash_empty_lines(s, 1); }},
+        {"transform_space_before_parens", 4,
+            [&](std::vector<Span> &s) {
+                transform_space_before_parens(s, SpaceBeforeParens::ControlStatements);
+            }},
+    };
+    auto selected = [&](const Axis &axis, const Benchmark &b) {
+        return filter.empty() || std::string{axis.name}.find(filter) != std::string::npos ||
+               std::string{b.name}.find(filter) != std::string::npos;
+    };
+
+    size_t failures = 0;
+    printf("%-24s %-36s %8s %10s  %s\n", "axis", "benchmark", "points", "exponent", "result");
+    for (const auto &axis : axes()) {
+        std::vector<std::vector<Measurement>> measurements(benchmarks.size());
+        std::vector<bool> running(benchmarks.size());
+        for (size_t i = 0; i < benchmarks.size(); i++) {
+            running[i] = selected(axis, benchmarks[i]);
+        }
+
+        for (size_t size = min_size; size <= max_size; size *= 2) {
+            if (std::none_of(running.begin(), running.end(), [](bool b) { return b; })) {
+                break;
+            }
+            input = axis.make_input(size);
+            format(input, options, output, context);
+            const size_t work = input.size() + output.size();
+            const size_t runs = work < 1024 * 1024 ? 5 : 3;
+
+            // Only one snapshot of the pipeline is kept at a time, since at the largest sizes
+            // each takes a lot of memory.
+            std::vector<Span> snapshot = parse(input);
+            std::vector<Span> spans;
+            for (int stage = 0; stage <= 4; stage++) {
+                if (stage == 2) {
+                    transform_indent(snapshot, indent_string);
+                } else if (stage == 3) {
+                    transform_loosen_loop_constructs(snapshot);
+                } else if (stage == 4) {
+                    transform_argument_bin_pack(snapshot, column_limit, indent_string);
+                }
+                const double reference_seconds = time_best_of(runs, [] {}, [&] {
+                    std::vector<Span> spans_copy{snapshot};
+                    std::string output_copy{output};
+                });
+
+                for (size_t i = 0; i < benchmarks.size(); i++) {
+                    const Benchmark &b = benchmarks[i];
+                    if (b.stage != stage || !running[i]) {
+                        continue;
+                    }
+                    const double seconds = time_best_of(runs,
+                        [&] {
+                            if (stage > 0) {
+                                spans = snapshot;
+                            }
+                        },
+                        [&] { b.run(spans); });
+                    if (verbose) {
+                        printf("  %s / %s: %zu bytes: %.6f s (copying spans: %.6f s)\n",
+                            axis.name, b.name, work, seconds, reference_seconds);
+                    }
+                    if (seconds >= min_fit_seconds) {
+                        measurements[i].push_back({work, seconds, reference_seconds});
+                    }
+                    if (seconds >= max_seconds) {
+                        running[i] = false;
+                    }
+                }
+            }
+            fflush(stdout);
+        }
+
+        for (size_t i = 0; i < benchmarks.size(); i++) {
+            if (!selected(axis, benchmarks[i])) {
+                continue;
+            }
+            // Only the largest sizes say much about growth.
+            std::vector<Measurement> &m = measurements[i];
+            if (m.size() > 6) {
+                m.erase(m.begin(), m.end() - 6);
+            }
+            if (m.size() < 3) {
+                printf("%-24s %-36s %8zu %10s  %s\n", axis.name, benchmarks[i].name, m.size(),
+                    "-", "too fast to measure");
+                continue;
+            }
+            const double exponent = growth_exponent(m);
+            const bool ok = exponent <= max_exponent;
+            printf("%-24s %-36s %8zu %10.2f  %s\n", axis.name, benchmarks[i].name, m.size(),
+                exponent, ok ? "ok" : "FAILED");
+            if (!ok) {
+                failures++;
+            }
+        }
+    }
+
+    if (failures) {
+        printf("%zu benchmarks grew faster than n^%.2f\n", failures, max_exponent);
+        return 1;
+    }
+    return 0;
+}
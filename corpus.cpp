@@ -0,0 +1,316 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <random>
+#include <vector>
+
+#include "corpus.h"
+#include "helpers.h"
+
+namespace {
+
+// std::mt19937's output is fully specified, but the standard distributions aren't, so do the
+// arithmetic here to get the same corpus everywhere.
+struct Random {
+    explicit Random(uint32_t seed) : engine{seed} {
+    }
+
+    // In [0, n).
+    size_t below(size_t n) {
+        return n == 0 ? 0 : engine() % n;
+    }
+    // In [low, high].
+    size_t between(size_t low, size_t high) {
+        return high <= low ? low : low + below(high - low + 1);
+    }
+    bool percent(size_t chance) {
+        return below(100) < chance;
+    }
+    template <typename T, size_t N> const T &pick(const T (&values)[N]) {
+        return values[below(N)];
+    }
+
+    std::mt19937 engine;
+};
+
+struct Generator {
+    Generator(const CorpusOptions &options_) : options(options_), random{options_.seed} {
+    }
+
+    void indent() {
+        // Deliberately untidy, so there's something to reformat.
+        out += repeat_string(" ", depth * 2 + random.between(0, 2) * random.below(2));
+    }
+
+    void blank_lines() {
+        if (random.percent(options.blank_line_percent)) {
+            out += std::string(random.between(1, options.max_blank_run), '\n');
+        }
+    }
+
+    void comment() {
+        if (!random.percent(options.comment_percent)) {
+            return;
+        }
+        static const char *const words[] = {"Build", "the", "library", "TODO:", "remove", "this",
+            "once", "${VAR}", "is", "set", "(see", "below)", "#", "\"quoted\""};
+        if (random.percent(options.bracket_percent)) {
+            // The lexer only sees a bracket comment if a newline follows the bracket.
+            indent();
+            out += "#[[\n";
+            for (size_t i = random.between(1, options.max_comment_run); i > 0; i--) {
+                out += std::string{random.pick(words)} + " " + random.pick(words) + "\n";
+            }
+            out += "]]\n";
+            return;
+        }
+        for (size_t i = random.between(1, options.max_comment_run); i > 0; i--) {
+            indent();
+            out += "#";
+            for (size_t w = random.between(0, 8); w > 0; w--) {
+                out += std::string{" "} + random.pick(words);
+            }
+            out += "\n";
+        }
+    }
+
+    std::string name(const char *prefix) {
+        return prefix + std::to_string(random.below(1000));
+    }
+
+    std::string unquoted_argument() {
+        switch (random.below(6)) {
+        case 0:
+            return name("VAR_");
+        case 1:
+            return "${" + name("VAR_") + "}";
+        case 2:
+            return "src/" + name("dir_") + "/" + name("file_") + ".cpp";
+        case 3: {
+            static const char *const keywords[] = {"PUBLIC", "PRIVATE", "INTERFACE", "STATIC",
+                "SHARED", "REQUIRED", "COMPONENTS", "APPEND", "FORCE", "CACHE", "STRING",
+                "NAMES", "PATHS", "DESTINATION", "TARGETS", "ON", "OFF"};
+            return random.pick(keywords);
+        }
+        case 4:
+            return "-D" + name("DEFINE_") + "=" + std::to_string(random.below(100));
+        default:
+            return "a;list;of;" + name("item_");
+        }
+    }
+
+    std::string quoted_argument() {
+        static const char *const words[] = {"some", "text", "${VAR}", "with", "\\\"escaped\\\"",
+            "quotes", "and", "(parens)", "# not a comment", "\\n"};
+        std::string text = "\"";
+        for (size_t w = random.between(0, 6); w > 0; w--) {
+            text += std::string{random.pick(words)} + (w > 1 ? " " : "");
+        }
+        return text + "\"";
+    }
+
+    std::string bracket_argument() {
+        const std::string equals(random.below(3), '=');
+        std::string text = "[" + equals + "[";
+        text += random.percent(50) ? "raw ]] text" : "multi\nline ${not_expanded}\n";
+        return text + "]" + equals + "]";
+    }
+
+    std::string generator_expression() {
+        static const char *const expressions[] = {"$<$<CONFIG:Debug>:-O0>",
+            "$<TARGET_FILE:target_1>", "$<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>",
+            "$<$<AND:$<CXX_COMPILER_ID:GNU>,$<VERSION_LESS:$<CXX_COMPILER_VERSION>,5>>:-Wno-x>",
+            "$<INSTALL_INTERFACE:include>", "$<$<BOOL:${USE_X}>:X_ENABLED>"};
+        return random.pick(expressions);
+    }
+
+    std::string argument() {
+        const size_t roll = random.below(100);
+        if (roll < options.quoted_percent) {
+            return quoted_argument();
+        } else if (roll < options.quoted_percent + options.bracket_percent) {
+            return bracket_argument();
+        } else if (roll < options.quoted_percent + options.bracket_percent +
+                              options.generator_expression_percent) {
+            return generator_expression();
+        }
+        return unquoted_argument();
+    }
+
+    void command(const std::string &identifier, const std::vector<std::string> &fixed_arguments,
+        size_t extra_arguments) {
+        indent();
+        out += random.percent(options.upper_case_percent) ? upperstring(identifier) : identifier;
+        out += "(";
+        bool first = true;
+        auto separate = [&] {
+            if (!first && random.percent(options.newline_percent)) {
+                out += "\n";
+                indent();
+                out += "    ";
+            } else if (!first) {
+                out += " ";
+            }
+            first = false;
+        };
+        for (const auto &a : fixed_arguments) {
+            separate();
+            out += a;
+        }
+        for (size_t i = 0; i < extra_arguments; i++) {
+            separate();
+            out += argument();
+        }
+        out += ")";
+        if (random.percent(options.comment_percent / 2)) {
+            out += "  # trailing comment";
+        }
+        out += "\n";
+    }
+
+    size_t extra_arguments() {
+        return random.between(options.min_arguments, options.max_arguments);
+    }
+
+    void block(const char *open, const std::vector<std::string> &arguments, const char *close) {
+        command(open, arguments, 0);
+        depth++;
+        for (size_t i = random.between(1, 4); i > 0; i--) {
+            statement();
+        }
+        depth--;
+        command(close, {}, 0);
+    }
+
+    void statement() {
+        blank_lines();
+        comment();
+
+        const bool can_nest = depth < options.max_depth;
+        const size_t weights[] = {options.weight_set, can_nest ? options.weight_if : 0,
+            can_nest ? options.weight_foreach : 0,
+            can_nest && depth == 0 ? options.weight_function : 0, options.weight_add_library,
+            options.weight_target, options.weight_message, options.weight_other};
+        size_t total = 0;
+        for (size_t w : weights) {
+            total += w;
+        }
+        size_t roll = random.below(total);
+        size_t kind = 0;
+        while (kind + 1 < sizeof(weights) / sizeof(weights[0]) && roll >= weights[kind]) {
+            roll -= weights[kind];
+            kind++;
+        }
+
+        switch (kind) {
+        case 0:
+            command("set", {name("VAR_")}, extra_arguments());
+            break;
+        case 1:
+            command("if", {name("COND_"), "AND", "NOT", name("OTHER_")}, 0);
+            depth++;
+            for (size_t i = random.between(1, 3); i > 0; i--) {
+                statement();
+            }
+            if (random.percent(30)) {
+                depth--;
+                command("else", {}, 0);
+                depth++;
+                statement();
+            }
+            depth--;
+            command("endif", {}, 0);
+            break;
+        case 2:
+            block("foreach", {"item", "IN", "LISTS", name("LIST_")}, "endforeach");
+            break;
+        case 3:
+            block("function", {name("function_"), "arg"}, "endfunction");
+            break;
+        case 4:
+            command("add_library", {name("target_"), "STATIC"}, extra_arguments());
+            break;
+        case 5:
+            command("target_link_libraries", {name("target_"), "PUBLIC"}, extra_arguments());
+            break;
+        case 6:
+            command("message", {"STATUS", quoted_argument()}, 0);
+            break;
+        default:
+            command(name("custom_command_"), {}, extra_arguments());
+            break;
+        }
+    }
+
+    const CorpusOptions &options;
+    Random random;
+    size_t depth = 0;
+    std::string out;
+};
+
+} // namespace
+
+std::string generate_corpus(const CorpusOptions &options) {
+    Generator generator{options};
+    std::string &out = generator.out;
+    out.reserve(options.size + options.add_library_sources * 24 + 1024);
+
+    if (options.add_library_sources > 0) {
+        out += "add_library(huge_library STATIC";
+        for (size_t i = 0; i < options.add_library_sources; i++) {
+            out += i % 8 == 0 ? "\n    " : " ";
+            out += "src/source_" + std::to_string(i) + ".cpp";
+        }
+        out += ")\n";
+    }
+    while (out.size() < options.size) {
+        generator.statement();
+    }
+    return out;
+}
+
+TEST_CASE("Generates CMake code that parses") {
+    CorpusOptions options;
+    options.size = 16 * 1024;
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+        options.seed = seed;
+        const std::string corpus = generate_corpus(options);
+        REQUIRE(corpus.size() >= options.size);
+        REQUIRE_PARSES(corpus);
+    }
+
+    // Every kind of argument, and deep nesting.
+    options.seed = 1;
+    options.quoted_percent = 30;
+    options.bracket_percent = 30;
+    options.generator_expression_percent = 30;
+    options.comment_percent = 100;
+    options.max_depth = 10;
+    options.weight_if = 20;
+    const std::string corpus = generate_corpus(options);
+    REQUIRE(corpus.find("[[") != std::string::npos);
+    REQUIRE(corpus.find("$<") != std::string::npos);
+    REQUIRE_PARSES(corpus);
+}
+
+TEST_CASE("Generates the same corpus from the same seed") {
+    CorpusOptions options;
+    options.size = 4096;
+    const std::string first = generate_corpus(options);
+    REQUIRE(generate_corpus(options) == first);
+    options.seed = 2;
+    REQUIRE(generate_corpus(options) != first);
+}
+
+TEST_CASE("Generates a long add_library()") {
+    CorpusOptions options;
+    options.size = 0;
+    options.add_library_sources = 1000;
+    const std::vector<Span> spans = parse(generate_corpus(options));
+    size_t arguments = 0;
+    for (const auto &s : spans) {
+        arguments += s.type == SpanType::Unquoted ? 1 : 0;
+    }
+    REQUIRE(arguments == 1002);
+}
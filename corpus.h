@@ -0,0 +1,53 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Shapes the CMake code made by generate_corpus(). Probabilities are percentages.
+struct CorpusOptions {
+    uint32_t seed = 1;
+    // Keep adding top-level statements until the output is at least this many bytes.
+    size_t size = 64 * 1024;
+
+    // Relative weights of each kind of statement.
+    size_t weight_set = 4;
+    size_t weight_if = 2;
+    size_t weight_foreach = 1;
+    size_t weight_function = 1;
+    size_t weight_add_library = 2;
+    size_t weight_target = 2;
+    size_t weight_message = 2;
+    size_t weight_other = 2;
+
+    // Number of arguments to ordinary commands, on top of any they always have.
+    size_t min_arguments = 0;
+    size_t max_arguments = 12;
+    // If not 0, start with one add_library() with exactly this many sources.
+    size_t add_library_sources = 0;
+    // How deeply if(), foreach() and function() blocks may nest.
+    size_t max_depth = 3;
+
+    size_t comment_percent = 10;
+    // A comment is a run of 1 to this many lines.
+    size_t max_comment_run = 3;
+    size_t blank_line_percent = 15;
+    // Blank lines come in runs of 1 to this many.
+    size_t max_blank_run = 2;
+
+    // What kind of argument each argument is; the rest are plain unquoted arguments.
+    size_t quoted_percent = 15;
+    size_t bracket_percent = 3;
+    size_t generator_expression_percent = 5;
+    // Chance of an argument going on its own line.
+    size_t newline_percent = 15;
+    // Chance of a command name being written in upper case.
+    size_t upper_case_percent = 20;
+};
+
+// Makes made-up but valid CMake code, which always parses. The same options always give the
+// same output, on every platform.
+std::string generate_corpus(const CorpusOptions &options);
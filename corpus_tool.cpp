@@ -0,0 +1,126 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// Writes synthetic CMake code for benchmarks and fuzzers.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "command_line.h"
+#include "corpus.h"
+#include "helpers.h"
+
+int main(int argc, char **argv) {
+    CorpusOptions options;
+    size_t seed = options.seed;
+    size_t count = 1;
+    std::string directory;
+
+    const static std::string description =
+        "Writes made-up CMake code to standard output. The same options always give the same\n"
+        "output. With -directory, writes -count files instead, seeded from -seed upwards.";
+    static std::vector<SwitchOptionDescription> switch_options = {};
+    const static std::vector<ArgumentOptionDescription> argument_options = {
+        {"-add-library-sources", "NUMBER",
+            "Start with an add_library() with NUMBER sources.",
+            parse_numeric_option(options.add_library_sources)},
+        {"-blank-lines", "PERCENT", "Chance of blank lines before a statement.",
+            parse_numeric_option(options.blank_line_percent)},
+        {"-blank-run", "NUMBER", "Most blank lines in a row.",
+            parse_numeric_option(options.max_blank_run)},
+        {"-bracket", "PERCENT", "Share of bracket arguments, and of bracket comments.",
+            parse_numeric_option(options.bracket_percent)},
+        {"-comment-run", "NUMBER", "Most comment lines in a row.",
+            parse_numeric_option(options.max_comment_run)},
+        {"-comments", "PERCENT", "Chance of a comment before a statement.",
+            parse_numeric_option(options.comment_percent)},
+        {"-count", "NUMBER", "Number of files to write with -directory.",
+            parse_numeric_option(count)},
+        {"-depth", "NUMBER", "How deeply if(), foreach() and function() may nest.",
+            parse_numeric_option(options.max_depth)},
+        {"-directory", "DIR", "Write files named corpus-SEED.cmake into DIR.",
+            [&](const std::string &value) { directory = value; }},
+        {"-generator-expressions", "PERCENT", "Share of generator expression arguments.",
+            parse_numeric_option(options.generator_expression_percent)},
+        {"-max-arguments", "NUMBER", "Most extra arguments to a command.",
+            parse_numeric_option(options.max_arguments)},
+        {"-min-arguments", "NUMBER", "Fewest extra arguments to a command.",
+            parse_numeric_option(options.min_arguments)},
+        {"-mix", "KIND:WEIGHT,...",
+            "Relative weights of the kinds of statement: set, if, foreach, function, "
+            "add_library, target, message, other.",
+            [&](const std::string &value) {
+                size_t start = 0;
+                while (start < value.size()) {
+                    size_t end = value.find(',', start);
+                    if (end == std::string::npos) {
+                        end = value.size();
+                    }
+                    const std::string item = value.substr(start, end - start);
+                    const size_t colon = item.find(':');
+                    if (colon == std::string::npos) {
+                        throw opterror;
+                    }
+                    const std::string kind = item.substr(0, colon);
+                    size_t weight;
+                    parse_numeric_option(weight)(item.substr(colon + 1));
+                    if (kind == "set") {
+                        options.weight_set = weight;
+                    } else if (kind == "if") {
+                        options.weight_if = weight;
+                    } else if (kind == "foreach") {
+                        options.weight_foreach = weight;
+                    } else if (kind == "function") {
+                        options.weight_function = weight;
+                    } else if (kind == "add_library") {
+                        options.weight_add_library = weight;
+                    } else if (kind == "target") {
+                        options.weight_target = weight;
+                    } else if (kind == "message") {
+                        options.weight_message = weight;
+                    } else if (kind == "other") {
+                        options.weight_other = weight;
+                    } else {
+                        throw opterror;
+                    }
+                    start = end + 1;
+                }
+            }},
+        {"-newlines", "PERCENT", "Chance of an argument starting a new line.",
+            parse_numeric_option(options.newline_percent)},
+        {"-quoted", "PERCENT", "Share of quoted arguments.",
+            parse_numeric_option(options.quoted_percent)},
+        {"-seed", "NUMBER", "Seed for the random choices.", parse_numeric_option(seed)},
+        {"-size", "BYTES", "Size to generate, roughly.", parse_numeric_option(options.size)},
+        {"-upper-case", "PERCENT", "Chance of a command name in upper case.",
+            parse_numeric_option(options.upper_case_percent)},
+    };
+    const std::vector<std::string> positional =
+        parse_command_line(argc, argv, description, switch_options, argument_options);
+    if (!positional.empty()) {
+        fprintf(stderr, "%s: takes no filenames. Try: %s -help\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    if (directory.empty()) {
+        options.seed = static_cast<uint32_t>(seed);
+        std::cout << generate_corpus(options);
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        options.seed = static_cast<uint32_t>(seed + i);
+        const std::string filename =
+            directory + "/corpus-" + std::to_string(options.seed) + ".cmake";
+        std::ofstream file{filename, std::ios::binary};
+        file << generate_corpus(options);
+        if (!file) {
+            fprintf(stderr, "%s: can't write '%s'\n", argv[0], filename.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// The replacement global operator new and delete that count allocations. They're linked into the
+// executables rather than the cmakeformat library, so that a shared library made from it, like
+// cmakeformat_c, doesn't replace the operators of whatever program loads it.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "allocations.h"
+
+#ifdef CMAKEFORMAT_COUNT_ALLOCATIONS
+
+// Each allocation is preceded by its size, so that deleting it can take the size off the heap
+// usage; the header is big enough to keep what follows it aligned for any type.
+union AllocationHeader {
+    size_t size;
+    std::max_align_t align;
+};
+
+static void *counted_allocation(size_t size) noexcept {
+    void *p = std::malloc(sizeof(AllocationHeader) + size);
+    if (!p) {
+        return nullptr;
+    }
+    static_cast<AllocationHeader *>(p)->size = size;
+    record_allocation(size);
+    return static_cast<AllocationHeader *>(p) + 1;
+}
+
+static void counted_free(void *p) noexcept {
+    if (!p) {
+        return;
+    }
+    AllocationHeader *header = static_cast<AllocationHeader *>(p) - 1;
+    record_deallocation(header->size);
+    std::free(header);
+}
+
+void *operator new(size_t size) {
+    void *p;
+    while (!(p = counted_allocation(size))) {
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc{};
+        }
+        handler();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return counted_allocation(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return counted_allocation(size);
+}
+
+void operator delete(void *p) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    counted_free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, size_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    counted_free(p);
+}
+#endif
+
+#endif
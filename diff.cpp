@@ -0,0 +1,512 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include "diff.h"
+#include "helpers.h"
+
+static const size_t context_lines = 3;
+
+namespace {
+
+struct Line {
+    size_t begin;
+    size_t size;
+    // Equal lines, in either file, have equal ids.
+    size_t id;
+};
+
+struct LineKey {
+    const char *data;
+    size_t size;
+    uint64_t hash;
+};
+
+struct LineKeyHash {
+    size_t operator()(const LineKey &key) const {
+        return static_cast<size_t>(key.hash);
+    }
+};
+
+struct LineKeyEqual {
+    bool operator()(const LineKey &x, const LineKey &y) const {
+        return x.size == y.size && std::memcmp(x.data, y.data, x.size) == 0;
+    }
+};
+
+using LineIds = std::unordered_map<LineKey, size_t, LineKeyHash, LineKeyEqual>;
+
+// Lines keep their terminating newline, so a last line without one differs from the same
+// text with one, as it does for diff.
+void split_lines(const std::string &text, LineIds &ids, std::vector<Line> &lines) {
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        end = end == std::string::npos ? text.size() : end + 1;
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = begin; i < end; i++) {
+            hash = (hash ^ static_cast<unsigned char>(text[i])) * 1099511628211ull;
+        }
+        const size_t id =
+            ids.emplace(LineKey{&text[begin], end - begin, hash}, ids.size()).first->second;
+        lines.push_back(Line{begin, end - begin, id});
+        begin = end;
+    }
+}
+
+// Myers' O(ND) difference algorithm, with the linear space refinement: each step finds the
+// middle snake of the shortest edit script by running the search forwards and backwards at
+// once, then recurses on either side of it. The result is a changed flag for every line of
+// each side.
+//
+// Lines that don't appear anywhere in the other file can't be part of the longest common
+// subsequence, so they are marked changed up front and left out of the search. For a
+// reformatted file, where most changed lines are unique, that keeps D small.
+struct Differ {
+    Differ(const std::string &a_text, const std::string &b_text) {
+        LineIds ids;
+        split_lines(a_text, ids, a);
+        split_lines(b_text, ids, b);
+        // Flags have a zero sentinel at each end, which slide_changes() relies on.
+        a_changed.assign(a.size() + 2, 0);
+        b_changed.assign(b.size() + 2, 0);
+
+        std::vector<char> in_a(ids.size(), 0);
+        std::vector<char> in_b(ids.size(), 0);
+        for (const auto &line : a) {
+            in_a[line.id] = 1;
+        }
+        for (const auto &line : b) {
+            in_b[line.id] = 1;
+        }
+        for (size_t i = 0; i < a.size(); i++) {
+            if (in_b[a[i].id]) {
+                a_ids.push_back(a[i].id);
+                a_index.push_back(i);
+            } else {
+                a_changed[i + 1] = 1;
+            }
+        }
+        for (size_t j = 0; j < b.size(); j++) {
+            if (in_a[b[j].id]) {
+                b_ids.push_back(b[j].id);
+                b_index.push_back(j);
+            } else {
+                b_changed[j + 1] = 1;
+            }
+        }
+
+        too_expensive = 1;
+        for (size_t diagonals = a_ids.size() + b_ids.size() + 3; diagonals != 0;
+             diagonals >>= 2) {
+            too_expensive <<= 1;
+        }
+        too_expensive = std::max<std::ptrdiff_t>(4096, too_expensive);
+
+        compare(0, a_ids.size(), 0, b_ids.size());
+        slide_changes(a, &a_changed[1], &b_changed[1]);
+        slide_changes(b, &b_changed[1], &a_changed[1]);
+    }
+
+    bool equal(size_t i, size_t j) const {
+        return a_ids[i] == b_ids[j];
+    }
+
+    void mark_changed(size_t a_lo, size_t a_hi, size_t b_lo, size_t b_hi) {
+        for (size_t i = a_lo; i < a_hi; i++) {
+            a_changed[a_index[i] + 1] = 1;
+        }
+        for (size_t j = b_lo; j < b_hi; j++) {
+            b_changed[b_index[j] + 1] = 1;
+        }
+    }
+
+    void compare(size_t a_lo, size_t a_hi, size_t b_lo, size_t b_hi) {
+        while (a_lo < a_hi && b_lo < b_hi && equal(a_lo, b_lo)) {
+            a_lo++;
+            b_lo++;
+        }
+        while (a_lo < a_hi && b_lo < b_hi && equal(a_hi - 1, b_hi - 1)) {
+            a_hi--;
+            b_hi--;
+        }
+        if (a_lo == a_hi || b_lo == b_hi) {
+            mark_changed(a_lo, a_hi, b_lo, b_hi);
+            return;
+        }
+
+        size_t x, y;
+        if (!bisect(a_lo, a_hi, b_lo, b_hi, x, y) || (x == a_lo && y == b_lo) ||
+            (x == a_hi && y == b_hi)) {
+            mark_changed(a_lo, a_hi, b_lo, b_hi);
+            return;
+        }
+        compare(a_lo, x, b_lo, y);
+        compare(x, a_hi, y, b_hi);
+    }
+
+    // Finds where the forward and backward searches meet. Past too_expensive edits, settles for
+    // the point the forward search has got furthest along, like diff does.
+    bool bisect(size_t a_lo, size_t a_hi, size_t b_lo, size_t b_hi, size_t &x_out, size_t &y_out) {
+        const std::ptrdiff_t n = a_hi - a_lo;
+        const std::ptrdiff_t m = b_hi - b_lo;
+        const std::ptrdiff_t max_d = (n + m + 1) / 2;
+        const std::ptrdiff_t v_offset = max_d;
+        const std::ptrdiff_t v_length = 2 * max_d + 2;
+        // Scratch space is only needed until the split is found, so every level of the
+        // recursion shares it.
+        if (v.size() < static_cast<size_t>(2 * v_length)) {
+            v.resize(2 * v_length);
+        }
+        std::ptrdiff_t *v1 = &v[0];
+        std::ptrdiff_t *v2 = &v[v_length];
+        std::fill(v1, v1 + 2 * v_length, -1);
+        v1[v_offset + 1] = 0;
+        v2[v_offset + 1] = 0;
+
+        const std::ptrdiff_t delta = n - m;
+        const bool front = (delta % 2) != 0;
+        std::ptrdiff_t k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+        for (std::ptrdiff_t d = 0; d < max_d; d++) {
+            for (std::ptrdiff_t k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+                const std::ptrdiff_t k1_offset = v_offset + k1;
+                std::ptrdiff_t x1;
+                if (k1 == -d || (k1 != d && v1[k1_offset - 1] < v1[k1_offset + 1])) {
+                    x1 = v1[k1_offset + 1];
+                } else {
+                    x1 = v1[k1_offset - 1] + 1;
+                }
+                std::ptrdiff_t y1 = x1 - k1;
+                while (x1 < n && y1 < m && equal(a_lo + x1, b_lo + y1)) {
+                    x1++;
+                    y1++;
+                }
+                v1[k1_offset] = x1;
+                if (x1 > n) {
+                    k1end += 2;
+                } else if (y1 > m) {
+                    k1start += 2;
+                } else if (front) {
+                    const std::ptrdiff_t k2_offset = v_offset + delta - k1;
+                    if (k2_offset >= 0 && k2_offset < v_length && v2[k2_offset] != -1 &&
+                        x1 >= n - v2[k2_offset]) {
+                        x_out = a_lo + x1;
+                        y_out = b_lo + y1;
+                        return true;
+                    }
+                }
+            }
+
+            for (std::ptrdiff_t k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+                const std::ptrdiff_t k2_offset = v_offset + k2;
+                std::ptrdiff_t x2;
+                if (k2 == -d || (k2 != d && v2[k2_offset - 1] < v2[k2_offset + 1])) {
+                    x2 = v2[k2_offset + 1];
+                } else {
+                    x2 = v2[k2_offset - 1] + 1;
+                }
+                std::ptrdiff_t y2 = x2 - k2;
+                while (x2 < n && y2 < m && equal(a_hi - 1 - x2, b_hi - 1 - y2)) {
+                    x2++;
+                    y2++;
+                }
+                v2[k2_offset] = x2;
+                if (x2 > n) {
+                    k2end += 2;
+                } else if (y2 > m) {
+                    k2start += 2;
+                } else if (!front) {
+                    const std::ptrdiff_t k1_offset = v_offset + delta - k2;
+                    if (k1_offset >= 0 && k1_offset < v_length && v1[k1_offset] != -1) {
+                        const std::ptrdiff_t x1 = v1[k1_offset];
+                        const std::ptrdiff_t y1 = v_offset + x1 - k1_offset;
+                        if (x1 >= n - x2) {
+                            x_out = a_lo + x1;
+                            y_out = b_lo + y1;
+                            return true;
+                        }
+                    }
+                }
+            }
+
+            if (d >= too_expensive) {
+                std::ptrdiff_t best = -1;
+                for (std::ptrdiff_t k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+                    const std::ptrdiff_t x1 = std::min(v1[v_offset + k1], n);
+                    const std::ptrdiff_t y1 = x1 - k1;
+                    if (y1 >= 0 && y1 <= m && x1 + y1 > best) {
+                        best = x1 + y1;
+                        x_out = a_lo + x1;
+                        y_out = b_lo + y1;
+                    }
+                }
+                return best > 0;
+            }
+        }
+        return false;
+    }
+
+    // A run of changed lines that borders on lines identical to its own can be moved without
+    // changing the result. Settle each run where diff would: slide it up and down over
+    // identical lines to merge it with neighbouring runs, and leave it as low as it will go,
+    // unless a higher position lines it up with a run of changes in the other file.
+    static void slide_changes(
+        const std::vector<Line> &lines, char *changed, const char *other_changed) {
+        const std::ptrdiff_t end = lines.size();
+        auto same = [&](std::ptrdiff_t x, std::ptrdiff_t y) { return lines[x].id == lines[y].id; };
+
+        // j follows i in the other file: it moves in step over unchanged lines, and over the
+        // other file's runs of changes wherever they are.
+        std::ptrdiff_t i = 0;
+        std::ptrdiff_t j = 0;
+        while (true) {
+            while (i < end && !changed[i]) {
+                while (other_changed[j]) {
+                    j++;
+                }
+                i++;
+                j++;
+            }
+            if (i == end) {
+                break;
+            }
+
+            std::ptrdiff_t run_begin = i;
+            while (changed[i]) {
+                i++;
+            }
+            while (other_changed[j]) {
+                j++;
+            }
+
+            std::ptrdiff_t run_length;
+            std::ptrdiff_t aligned_end;
+            do {
+                run_length = i - run_begin;
+
+                while (run_begin > 0 && same(run_begin - 1, i - 1)) {
+                    changed[--run_begin] = 1;
+                    changed[--i] = 0;
+                    while (changed[run_begin - 1]) {
+                        run_begin--;
+                    }
+                    do {
+                        j--;
+                    } while (other_changed[j]);
+                }
+
+                aligned_end = other_changed[j - 1] ? i : end;
+
+                while (i != end && same(run_begin, i)) {
+                    changed[run_begin++] = 0;
+                    changed[i++] = 1;
+                    while (changed[i]) {
+                        i++;
+                    }
+                    j++;
+                    while (other_changed[j]) {
+                        aligned_end = i;
+                        j++;
+                    }
+                }
+            } while (run_length != i - run_begin);
+
+            while (aligned_end < i) {
+                changed[--run_begin] = 1;
+                changed[--i] = 0;
+                do {
+                    j--;
+                } while (other_changed[j]);
+            }
+        }
+    }
+
+    std::vector<Line> a;
+    std::vector<Line> b;
+    // The lines left in the search, and where they are in a and b.
+    std::vector<size_t> a_ids;
+    std::vector<size_t> b_ids;
+    std::vector<size_t> a_index;
+    std::vector<size_t> b_index;
+    std::vector<char> a_changed;
+    std::vector<char> b_changed;
+    std::vector<std::ptrdiff_t> v;
+    std::ptrdiff_t too_expensive;
+};
+
+void write_range(std::ostream &out, size_t begin, size_t end) {
+    if (end == begin) {
+        out << begin << ",0";
+    } else if (end == begin + 1) {
+        out << end;
+    } else {
+        out << begin + 1 << ',' << end - begin;
+    }
+}
+
+void write_line(std::ostream &out, char prefix, const std::string &text, const Line &line) {
+    out << prefix;
+    out.write(&text[line.begin], line.size);
+    if (line.size == 0 || text[line.begin + line.size - 1] != '\n') {
+        out << "\n\\ No newline at end of file\n";
+    }
+}
+
+} // namespace
+
+bool write_unified_diff(std::ostream &out, const std::string &label, const std::string &original,
+    const std::string &formatted) {
+    if (original == formatted) {
+        return false;
+    }
+    const Differ differ{original, formatted};
+    const char *a_changed = &differ.a_changed[1];
+    const char *b_changed = &differ.b_changed[1];
+    const size_t n = differ.a.size();
+    const size_t m = differ.b.size();
+
+    struct Change {
+        size_t a_begin, a_end, b_begin, b_end;
+    };
+    std::vector<Change> changes;
+    size_t i = 0, j = 0;
+    while (i < n || j < m) {
+        if (i < n && j < m && !a_changed[i] && !b_changed[j]) {
+            i++;
+            j++;
+            continue;
+        }
+        Change change{i, i, j, j};
+        while (i < n && a_changed[i]) {
+            i++;
+        }
+        while (j < m && b_changed[j]) {
+            j++;
+        }
+        change.a_end = i;
+        change.b_end = j;
+        changes.push_back(change);
+    }
+
+    out << "--- " << label << "\n+++ " << label << "\n";
+    for (size_t first = 0; first < changes.size();) {
+        size_t last = first;
+        while (last + 1 < changes.size() &&
+               changes[last + 1].a_begin - changes[last].a_end <= 2 * context_lines) {
+            last++;
+        }
+        const size_t a_begin = changes[first].a_begin -
+                               std::min(context_lines, changes[first].a_begin);
+        const size_t b_begin = changes[first].b_begin - (changes[first].a_begin - a_begin);
+        const size_t a_end = std::min(n, changes[last].a_end + context_lines);
+        const size_t b_end = changes[last].b_end + (a_end - changes[last].a_end);
+
+        out << "@@ -";
+        write_range(out, a_begin, a_end);
+        out << " +";
+        write_range(out, b_begin, b_end);
+        out << " @@\n";
+
+        size_t a_pos = a_begin;
+        for (size_t c = first; c <= last; c++) {
+            for (; a_pos < changes[c].a_begin; a_pos++) {
+                write_line(out, ' ', original, differ.a[a_pos]);
+            }
+            for (; a_pos < changes[c].a_end; a_pos++) {
+                write_line(out, '-', original, differ.a[a_pos]);
+            }
+            for (size_t b_pos = changes[c].b_begin; b_pos < changes[c].b_end; b_pos++) {
+                write_line(out, '+', formatted, differ.b[b_pos]);
+            }
+        }
+        for (; a_pos < a_end; a_pos++) {
+            write_line(out, ' ', original, differ.a[a_pos]);
+        }
+        first = last + 1;
+    }
+    return true;
+}
+
+static inline std::string unified_diff(const std::string &original, const std::string &formatted) {
+    std::ostringstream out;
+    write_unified_diff(out, "file", original, formatted);
+    return out.str();
+}
+
+TEST_CASE("Writes nothing for identical files") {
+    REQUIRE(unified_diff("a\nb\n", "a\nb\n") == "");
+}
+
+TEST_CASE("Writes unified diffs") {
+    REQUIRE(unified_diff("1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n11\n12\n13\n14\n15\n16\n",
+                "1\n2\nthree\n4\n5\n6\n7\n8\n9\n10\n11\n12\n13\n14\n15\n16\nseventeen\n") ==
+            "--- file\n"
+            "+++ file\n"
+            "@@ -1,6 +1,6 @@\n"
+            " 1\n"
+            " 2\n"
+            "-3\n"
+            "+three\n"
+            " 4\n"
+            " 5\n"
+            " 6\n"
+            "@@ -14,3 +14,4 @@\n"
+            " 14\n"
+            " 15\n"
+            " 16\n"
+            "+seventeen\n");
+}
+
+TEST_CASE("Merges hunks separated by up to six lines") {
+    REQUIRE(unified_diff(
+                "1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n", "1\n2\nthree\n4\n5\n6\n7\n8\n9\nten\n") ==
+            "--- file\n"
+            "+++ file\n"
+            "@@ -1,10 +1,10 @@\n"
+            " 1\n"
+            " 2\n"
+            "-3\n"
+            "+three\n"
+            " 4\n"
+            " 5\n"
+            " 6\n"
+            " 7\n"
+            " 8\n"
+            " 9\n"
+            "-10\n"
+            "+ten\n");
+}
+
+TEST_CASE("Writes unified diffs of empty files") {
+    REQUIRE(unified_diff("", "a\n") == "--- file\n+++ file\n@@ -0,0 +1 @@\n+a\n");
+    REQUIRE(unified_diff("a\nb\n", "") == "--- file\n+++ file\n@@ -1,2 +0,0 @@\n-a\n-b\n");
+}
+
+TEST_CASE("Marks missing newlines at end of file") {
+    REQUIRE(unified_diff("a\nb", "a\nb\n") == "--- file\n"
+                                               "+++ file\n"
+                                               "@@ -1,2 +1,2 @@\n"
+                                               " a\n"
+                                               "-b\n"
+                                               "\\ No newline at end of file\n"
+                                               "+b\n");
+}
+
+TEST_CASE("Slides changes over identical lines like diff") {
+    REQUIRE(unified_diff("a\n)\n\nb\n)\n", "a\n)\n\nb\n)\n\nc\n)\n") ==
+            "--- file\n"
+            "+++ file\n"
+            "@@ -3,3 +3,6 @@\n"
+            " \n"
+            " b\n"
+            " )\n"
+            "+\n"
+            "+c\n"
+            "+)\n");
+}
@@ -0,0 +1,14 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+
+// Writes a unified diff with three lines of context from original to formatted, in the same
+// layout as `diff -u --label label --label label`. Writes nothing and returns false if the two
+// are the same.
+bool write_unified_diff(std::ostream &out, const std::string &label, const std::string &original,
+    const std::string &formatted);
@@ -0,0 +1,136 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// A libFuzzer target that looks for slow inputs, not just crashes: it parses and formats each
+// input with every reflow algorithm, and measures the CPU time that takes.
+//
+// The time is fed back to libFuzzer as extra coverage: each power-of-two bucket of time is a
+// counter, so an input slower than any seen before looks like new coverage, and is kept in the
+// corpus and mutated further. For the same reason, merging a corpus with -merge=1 keeps the
+// slowest input it has found as well as the ones that add code coverage.
+//
+// If CMAKEFORMAT_FUZZ_SLOW_DIR is set, every input that is the slowest yet and takes at least
+// CMAKEFORMAT_FUZZ_SLOW_MS milliseconds (default 10) is written there, as
+// slow-MICROSECONDS-HASH.cmake, for use as a regression benchmark with cmake-format-bench.
+//
+// Built without libFuzzer (CMAKEFORMAT_FUZZ_STANDALONE), it runs the files it's given once
+// each and prints how long they took, to reproduce what the fuzzer found.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include "cmakeformat.h"
+#include "helpers.h"
+#include "time_report.h"
+
+#ifndef CMAKEFORMAT_FUZZ_STANDALONE
+// Read by libFuzzer alongside its own coverage counters, and cleared before every input.
+__attribute__((used, section("__libfuzzer_extra_counters"))) static uint8_t slowness[32];
+#endif
+
+// CPU time to parse and format input with every reflow algorithm, in microseconds. Inputs
+// that don't parse, or that a transform rejects, are as interesting as any others: the time
+// until the error is still counted.
+static double format_cost_microseconds(const std::string &input) {
+    static FormatContext context;
+    static std::string output;
+    const ReflowArguments algorithms[] = {ReflowArguments::None, ReflowArguments::OnePerLine,
+        ReflowArguments::BinPack, ReflowArguments::Heuristic, ReflowArguments::BinPackBalanced};
+
+    const double start = thread_cpu_seconds();
+    for (ReflowArguments algorithm : algorithms) {
+        FormatOptions options;
+        options.reflow_arguments = algorithm;
+        try {
+            format(input, options, output, context);
+        } catch (const std::runtime_error &) {
+            // parseexception, or a construct the reflow transforms don't handle.
+        }
+    }
+    return (thread_cpu_seconds() - start) * 1e6;
+}
+
+static void write_slow_input(const std::string &input, double microseconds) {
+    static const char *directory = getenv("CMAKEFORMAT_FUZZ_SLOW_DIR");
+    static const double min_microseconds =
+        getenv("CMAKEFORMAT_FUZZ_SLOW_MS") ? atof(getenv("CMAKEFORMAT_FUZZ_SLOW_MS")) * 1000
+                                           : 10000;
+    static double slowest = 0;
+    if (!directory || microseconds < min_microseconds || microseconds <= slowest) {
+        return;
+    }
+    slowest = microseconds;
+
+    char name[64];
+    snprintf(name, sizeof(name), "slow-%.0f-%016llx.cmake", microseconds,
+        static_cast<unsigned long long>(std::hash<std::string>{}(input)));
+    const std::string filename = std::string{directory} + "/" + name;
+    std::ofstream file{filename, std::ios::binary};
+    file << input;
+    if (!file) {
+        fprintf(stderr, "cmake-format-fuzz: can't write '%s'\n", filename.c_str());
+    } else {
+        fprintf(stderr, "cmake-format-fuzz: %zu bytes took %.0f us: wrote %s\n", input.size(),
+            microseconds, filename.c_str());
+    }
+}
+
+// Times input, records the time for libFuzzer, and writes input out if it's slow.
+static double test_input(const std::string &input) {
+    double microseconds = format_cost_microseconds(input);
+
+    // Timing is noisy, so before believing an input is the slowest yet, time it again and
+    // take the faster of the two.
+    static double slowest = 0;
+    if (microseconds > slowest) {
+        microseconds = std::min(microseconds, format_cost_microseconds(input));
+        slowest = std::max(slowest, microseconds);
+    }
+
+#ifndef CMAKEFORMAT_FUZZ_STANDALONE
+    const double bucket = std::log2(std::max(microseconds, 1.0));
+    slowness[std::min(static_cast<size_t>(bucket), sizeof(slowness) - 1)] = 1;
+#endif
+    write_slow_input(input, microseconds);
+    return microseconds;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // The lexer reads a NUL-terminated string, so it would only see up to the first NUL.
+    if (std::find(data, data + size, '\0') != data + size) {
+        return 0;
+    }
+    test_input(std::string{reinterpret_cast<const char *>(data), size});
+    return 0;
+}
+
+#ifdef CMAKEFORMAT_FUZZ_STANDALONE
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s FILE...\n\nRuns each file through the fuzz target once, and "
+                        "prints how long it took.\n",
+            argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        std::ifstream file{argv[i], std::ios::binary};
+        if (!file) {
+            fprintf(stderr, "%s: can't read '%s'\n", argv[0], argv[i]);
+            return 1;
+        }
+        const std::string input{
+            std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        printf("%s: %zu bytes: %.0f us\n", argv[i], input.size(), test_input(input));
+    }
+    return 0;
+}
+#endif
@@ -2494,6 +2494,9 @@ static int cmListFileLexerInput(cmListFileLexer* lexer, char* buffer,
 /*--------------------------------------------------------------------------*/
 static void cmListFileLexerInit(cmListFileLexer* lexer)
 {
+  /* Token positions are relative to the start of each new input.  */
+  lexer->line = 1;
+  lexer->column = 1;
   if (lexer->file || lexer->string_buffer) {
     cmListFileLexer_yylex_init(&lexer->scanner);
     cmListFileLexer_yyset_extra(lexer, lexer->scanner);
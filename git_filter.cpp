@@ -0,0 +1,215 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "git_filter.h"
+#include "helpers.h"
+
+// See Documentation/technical/protocol-common.txt and long-running-process-protocol.txt in
+// git.git. A pkt-line is a four hex digit length (which includes itself) followed by the
+// payload; "0000" is a flush packet and terminates a list.
+static const size_t max_packet_payload = 65520 - 4;
+
+struct gitfilterexception : public std::runtime_error {
+    explicit gitfilterexception(const std::string &message)
+        : std::runtime_error{"git filter protocol: " + message} {
+    }
+};
+
+// Returns false for a flush packet.
+static bool read_packet(std::istream &in, std::string &payload) {
+    char header[4];
+    if (!in.read(header, 4)) {
+        throw gitfilterexception("unexpected end of input");
+    }
+    size_t length = 0;
+    for (char c : header) {
+        length <<= 4;
+        if (c >= '0' && c <= '9') {
+            length += c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            length += c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            length += c - 'A' + 10;
+        } else {
+            throw gitfilterexception("bad packet header '" + std::string{header, 4} + "'");
+        }
+    }
+    if (length == 0) {
+        return false;
+    }
+    if (length < 4) {
+        throw gitfilterexception("bad packet length " + std::to_string(length));
+    }
+    payload.resize(length - 4);
+    if (!in.read(&payload[0], payload.size())) {
+        throw gitfilterexception("unexpected end of input");
+    }
+    return true;
+}
+
+// Reads text packets up to the next flush, without their trailing newlines.
+static std::vector<std::string> read_text_list(std::istream &in) {
+    std::vector<std::string> lines;
+    std::string line;
+    while (read_packet(in, line)) {
+        if (!line.empty() && line.back() == '\n') {
+            line.pop_back();
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+static void read_content(std::istream &in, std::string &content) {
+    content.clear();
+    std::string packet;
+    while (read_packet(in, packet)) {
+        content += packet;
+    }
+}
+
+static void write_packet(std::ostream &out, const char *data, size_t size) {
+    char header[5];
+    snprintf(header, sizeof(header), "%04zx", size + 4);
+    out.write(header, 4);
+    out.write(data, size);
+}
+
+static void write_flush(std::ostream &out) {
+    out.write("0000", 4);
+}
+
+static void write_text_list(std::ostream &out, const std::vector<std::string> &lines) {
+    for (const auto &line : lines) {
+        const std::string packet = line + "\n";
+        write_packet(out, packet.data(), packet.size());
+    }
+    write_flush(out);
+}
+
+static void write_content(std::ostream &out, const std::string &content) {
+    for (size_t pos = 0; pos < content.size(); pos += max_packet_payload) {
+        write_packet(out, content.data() + pos, std::min(max_packet_payload, content.size() - pos));
+    }
+    write_flush(out);
+}
+
+static std::string find_value(const std::vector<std::string> &lines, const std::string &key) {
+    for (const auto &line : lines) {
+        if (line.compare(0, key.size() + 1, key + "=") == 0) {
+            return line.substr(key.size() + 1);
+        }
+    }
+    return "";
+}
+
+void run_git_filter_process(std::istream &in, std::ostream &out,
+    const std::function<std::string(const std::string &)> &format) {
+
+    const std::vector<std::string> welcome = read_text_list(in);
+    if (welcome.empty() || welcome[0] != "git-filter-client") {
+        throw gitfilterexception("expected 'git-filter-client'");
+    }
+    if (std::find(welcome.begin(), welcome.end(), "version=2") == welcome.end()) {
+        throw gitfilterexception("git does not support version 2");
+    }
+    write_text_list(out, {"git-filter-server", "version=2"});
+
+    std::vector<std::string> capabilities;
+    for (const auto &line : read_text_list(in)) {
+        if (line == "capability=clean" || line == "capability=smudge") {
+            capabilities.push_back(line);
+        }
+    }
+    write_text_list(out, capabilities);
+    out.flush();
+
+    std::string content;
+    while (in.peek() != std::char_traits<char>::eof()) {
+        const std::vector<std::string> request = read_text_list(in);
+        const std::string command = find_value(request, "command");
+        const std::string pathname = find_value(request, "pathname");
+        read_content(in, content);
+
+        if (command != "clean" && command != "smudge") {
+            write_text_list(out, {"status=error"});
+            out.flush();
+            continue;
+        }
+
+        std::string formatted;
+        try {
+            formatted = format(content);
+        } catch (const std::exception &e) {
+            fprintf(stderr, "%s: %s\n", pathname.c_str(), e.what());
+            write_text_list(out, {"status=error"});
+            out.flush();
+            continue;
+        }
+
+        write_text_list(out, {"status=success"});
+        write_content(out, formatted);
+        // An empty list keeps the status sent before the content.
+        write_flush(out);
+        out.flush();
+    }
+}
+
+static std::string encode_packets(const std::vector<std::string> &packets) {
+    std::ostringstream out;
+    for (const auto &p : packets) {
+        if (p.empty()) {
+            write_flush(out);
+        } else {
+            write_packet(out, p.data(), p.size());
+        }
+    }
+    return out.str();
+}
+
+TEST_CASE("Answers git filter requests") {
+    std::istringstream in{encode_packets({
+        "git-filter-client\n", "version=2\n", "",
+        "capability=clean\n", "capability=smudge\n", "capability=delay\n", "",
+        "command=smudge\n", "pathname=CMakeLists.txt\n", "", "command()\n", "",
+        "command=clean\n", "pathname=empty.cmake\n", "", "",
+        "command=smudge\n", "pathname=broken.cmake\n", "", "broken(\n", "",
+    })};
+    std::ostringstream out;
+
+    run_git_filter_process(in, out, [](const std::string &content) {
+        if (content.find('(') != std::string::npos &&
+            content.find(')') == std::string::npos) {
+            throw std::runtime_error("unbalanced");
+        }
+        return upperstring(content);
+    });
+
+    REQUIRE(out.str() == encode_packets({
+        "git-filter-server\n", "version=2\n", "",
+        "capability=clean\n", "capability=smudge\n", "",
+        "status=success\n", "", "COMMAND()\n", "", "",
+        "status=success\n", "", "", "",
+        "status=error\n", "",
+    }));
+}
+
+TEST_CASE("Splits large git filter responses into packets") {
+    std::ostringstream out;
+    write_content(out, std::string(max_packet_payload + 1, 'x'));
+    REQUIRE(out.str().size() == 4 + max_packet_payload + 4 + 1 + 4);
+    REQUIRE(out.str().compare(0, 4, "fff0") == 0);
+    REQUIRE(out.str().compare(4 + max_packet_payload, 5, "0005x") == 0);
+}
+
+TEST_CASE("Rejects clients that aren't git") {
+    std::istringstream in{encode_packets({"hello\n", ""})};
+    std::ostringstream out;
+    REQUIRE_THROWS(run_git_filter_process(in, out, [](const std::string &s) { return s; }));
+}
@@ -0,0 +1,16 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+
+// Speaks git's long-running filter protocol (version 2) over a pair of streams, as used by
+// `filter.<driver>.process`. Every clean and smudge request is answered with the result of
+// calling `format` on the blob contents. Returns when git closes the input stream.
+void run_git_filter_process(std::istream &in, std::ostream &out,
+    const std::function<std::string(const std::string &)> &format);
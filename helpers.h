@@ -6,9 +6,15 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdio>
 #include <functional>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
+#include "cmakeformat.h"
 #include "parser.h"
 
 #ifdef CMAKEFORMAT_BUILD_TESTS
@@ -23,17 +29,6 @@
 
 using namespace std::placeholders;
 
-enum class SpaceBeforeParens {
-    Never,
-    ControlStatements,
-    Always,
-};
-
-enum class LetterCase {
-    Lower,
-    Upper,
-};
-
 static inline void replace_all_in_string(
     std::string &main_string, const std::string &from, const std::string &to) {
     size_t pos = 0;
@@ -61,51 +56,153 @@ static inline std::string upperstring(const std::string &val) {
     return newval;
 }
 
-static inline std::string repeat_string(const std::string &val, size_t n) {
-    std::string newval;
+// The in-place versions below reuse the storage of the string they're given, so they don't
+// allocate once it's big enough; the transforms use them inside their per-command loops.
+static inline const std::string &lowercase_into(std::string &out, const std::string &val) {
+    out.assign(val);
+    std::transform(out.begin(), out.end(), out.begin(), [](char c) { return std::tolower(c); });
+    return out;
+}
+
+static inline void assign_repeated(std::string &out, const std::string &val, size_t n) {
+    out.clear();
     for (size_t i = 0; i < n; i++) {
-        newval += val;
+        out += val;
     }
-    return newval;
 }
 
-static inline void delete_span(std::vector<Span> &spans, size_t span_index) {
-    spans.erase(spans.begin() + span_index);
+static inline std::string repeat_string(const std::string &val, size_t n) {
+    std::string newval;
+    assign_repeated(newval, val, n);
+    return newval;
 }
 
-static inline void insert_span_at(
-    const size_t &span_index, std::vector<Span> &spans, const std::vector<Span> &new_spans) {
-    spans.insert(spans.begin() + span_index, new_spans.begin(), new_spans.end());
+// Writes text escaped for use inside a JSON string literal.
+static inline void write_json_escaped(std::ostream &out, const std::string &text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c == '\n') {
+            out << "\\n";
+        } else if (c == '\t') {
+            out << "\\t";
+        } else if (c == '\r') {
+            out << "\\r";
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[7];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
 }
 
-static inline void insert_span_at(
-    const size_t &span_index, std::vector<Span> &spans, const Span &new_span) {
-    return insert_span_at(span_index, spans, std::vector<Span>{new_span});
-}
+// Storage that SpanRewriter hands on from one rewrite to the next on the same thread, so that
+// rewriting doesn't allocate once it has seen as many spans as it's given.
+struct SpanRewriterScratch {
+    std::vector<Span> spans;
+    std::vector<std::string> strings;
+};
 
-static inline void insert_span_before(
-    size_t &span_index, std::vector<Span> &spans, const std::vector<Span> &new_spans) {
-    insert_span_at(span_index, spans, new_spans);
-    span_index += new_spans.size();
-}
+SpanRewriterScratch &span_rewriter_scratch();
+
+// Rewrites spans in a single pass. Spans are taken from the front of the old vector and kept,
+// dropped or preceded by new ones, building the new vector as it goes, so each edit costs O(1)
+// rather than shifting every later span the way vector::erase and vector::insert do. Whatever
+// hasn't been looked at yet is kept when the rewriter goes away.
+struct SpanRewriter {
+    explicit SpanRewriter(std::vector<Span> &spans_)
+        : spans(spans_), scratch(span_rewriter_scratch()) {
+        input.swap(spans);
+        spans.swap(scratch.spans);
+        spans.clear();
+        spans.reserve(input.size() + input.size() / 4);
+        recycled.swap(scratch.strings);
+        recycled.clear();
+    }
+    ~SpanRewriter() {
+        spans.insert(spans.end(), std::make_move_iterator(input.begin() + position),
+            std::make_move_iterator(input.end()));
+        input.clear();
+        scratch.spans.swap(input);
+        recycled.clear();
+        scratch.strings.swap(recycled);
+    }
+    SpanRewriter(const SpanRewriter &) = delete;
+    SpanRewriter &operator=(const SpanRewriter &) = delete;
 
-static inline void insert_span_before(
-    size_t &span_index, std::vector<Span> &spans, const Span &new_span) {
-    return insert_span_before(span_index, spans, std::vector<Span>{new_span});
-}
+    bool at_end() const {
+        return position >= input.size();
+    }
+    size_t remaining() const {
+        return input.size() - position;
+    }
+    // The span offset places after the next one to be kept or dropped.
+    Span &ahead(size_t offset = 0) {
+        return input[position + offset];
+    }
+    void keep(size_t count = 1) {
+        for (size_t i = 0; i < count; i++) {
+            spans.push_back(std::move(input[position++]));
+        }
+    }
+    // If the dropped span's text is too long to be stored inline, its storage is kept for
+    // insert() to reuse.
+    void drop() {
+        std::string &data = input[position++].data;
+        if (data.capacity() > std::string{}.capacity()) {
+            recycled.push_back(std::move(data));
+        }
+    }
+    // Reformatting already formatted code drops spaces and newlines and inserts the same ones
+    // again, which this does without allocating.
+    void insert(SpanType type, const std::string &data) {
+        spans.emplace_back(type, std::string{});
+        if (data.size() > std::string{}.capacity() && !recycled.empty()) {
+            spans.back().data.swap(recycled.back());
+            recycled.pop_back();
+        }
+        spans.back().data.assign(data);
+    }
+
+    // The rewritten spans so far.
+    std::vector<Span> &spans;
+    // The original spans; everything from position on is still to be rewritten.
+    std::vector<Span> input;
+    size_t position = 0;
+    // Storage from dropped spans.
+    std::vector<std::string> recycled;
+    SpanRewriterScratch &scratch;
+};
 
-static inline std::string get_command_indentation(
-    const size_t &identifier_span_index, std::vector<Span> &spans) {
-    const std::string ident = spans[identifier_span_index].data;
+// Sets indentation to the indentation of the command whose identifier is the next span to be
+// rewritten.
+static inline void get_command_indentation(const SpanRewriter &rewriter, std::string &indentation) {
+    const std::string &ident = rewriter.input[rewriter.position].data;
 
-    if (identifier_span_index == 0 || spans[identifier_span_index - 1].type == SpanType::Newline) {
-        return "";
-    } else if (spans[identifier_span_index - 1].type == SpanType::Space) {
-        return spans[identifier_span_index - 1].data;
+    if (rewriter.spans.empty() || rewriter.spans.back().type == SpanType::Newline) {
+        indentation.clear();
+    } else if (rewriter.spans.back().type == SpanType::Space) {
+        indentation.assign(rewriter.spans.back().data);
     } else {
         throw std::runtime_error("command '" + ident + "' not preceded by space or newline: '" +
-                                 spans[identifier_span_index - 1].data + "'");
+                                 rewriter.spans.back().data + "'");
+    }
+}
+
+// Drops the spaces and newlines up to the closing paren of a command's arguments, then keeps
+// it, starting a new line at indentation before it if on_own_line.
+static inline void close_arguments(
+    SpanRewriter &rewriter, bool on_own_line, const std::string &indentation) {
+    while (rewriter.ahead().type != SpanType::Rparen) {
+        rewriter.drop();
+    }
+    if (on_own_line) {
+        rewriter.insert(SpanType::Newline, "\n");
+        rewriter.insert(SpanType::Space, indentation);
     }
+    rewriter.keep();
 }
 
 static inline void REQUIRE_PARSES(std::string original) {
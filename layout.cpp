@@ -0,0 +1,293 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <limits>
+
+#include "layout.h"
+
+static constexpr size_t unbounded = std::numeric_limits<size_t>::max();
+
+static bool fits(size_t column, size_t width, size_t column_limit) {
+    return column <= column_limit && width <= column_limit - column;
+}
+
+// How wide the items from i on are up to the next line.
+static size_t width_to_line(const Doc &doc, size_t i) {
+    size_t width = 0;
+    for (; i < doc.items.size(); i++) {
+        const Doc::Kind kind = doc.items[i].kind;
+        if (kind == Doc::Kind::Line || kind == Doc::Kind::SoftLine ||
+            kind == Doc::Kind::HardLine) {
+            break;
+        }
+        if (kind == Doc::Kind::Text) {
+            width += doc.items[i].width;
+        }
+    }
+    return width;
+}
+
+// Sets measures[i], for each group that starts at i, to how wide it is with none of its lines
+// broken, plus whatever comes after it up to the next line, or unbounded if it has a hard line.
+static void measure_groups(const Doc &doc, std::vector<size_t> &measures) {
+    struct OpenGroup {
+        size_t flat_width_after;
+        size_t hard_lines_after;
+        size_t trailing_width;
+    };
+    thread_local std::vector<OpenGroup> groups;
+
+    measures.resize(doc.items.size());
+    groups.clear();
+    // Working backwards: the widths of everything from here on with no lines broken, and of
+    // everything up to the next line.
+    size_t flat_width = 0;
+    size_t hard_lines = 0;
+    size_t width_to_line = 0;
+    for (size_t i = doc.items.size(); i-- > 0;) {
+        const Doc::Item &item = doc.items[i];
+        switch (item.kind) {
+        case Doc::Kind::Text:
+            flat_width += item.width;
+            width_to_line += item.width;
+            break;
+        case Doc::Kind::Line:
+        case Doc::Kind::SoftLine:
+        case Doc::Kind::HardLine:
+            flat_width += item.kind == Doc::Kind::Line;
+            hard_lines += item.kind == Doc::Kind::HardLine;
+            width_to_line = 0;
+            break;
+        case Doc::Kind::EndGroup:
+            groups.push_back({flat_width, hard_lines, width_to_line});
+            break;
+        case Doc::Kind::BeginGroup:
+            if (groups.empty()) {
+                throw std::runtime_error("group begins without ending");
+            }
+            measures[i] = hard_lines != groups.back().hard_lines_after
+                              ? unbounded
+                              : flat_width - groups.back().flat_width_after +
+                                    groups.back().trailing_width;
+            groups.pop_back();
+            break;
+        default:
+            break;
+        }
+    }
+    if (!groups.empty()) {
+        throw std::runtime_error("group ends without beginning");
+    }
+}
+
+void print_doc(const Doc &doc, SpanRewriter &rewriter, size_t column, size_t column_limit) {
+    // A group, or a fill, and whether its lines are all unbroken. Outside of any, lines break.
+    struct Frame {
+        bool is_fill;
+        bool flat;
+    };
+    thread_local std::vector<size_t> measures_storage;
+    thread_local std::vector<Frame> frames_storage;
+    thread_local std::vector<const std::string *> indentations_storage;
+    static const std::string no_indentation;
+    // Looked up once, rather than at every use.
+    std::vector<size_t> &measures = measures_storage;
+    std::vector<Frame> &frames = frames_storage;
+    std::vector<const std::string *> &indentations = indentations_storage;
+
+    // Drops the spans up to offset, counting from where the rewriter started.
+    const size_t start = rewriter.position;
+    auto drop_to = [&](size_t offset) {
+        while (rewriter.position < start + offset) {
+            rewriter.drop();
+        }
+    };
+
+    if (doc.has_groups) {
+        measure_groups(doc, measures);
+    }
+    frames.clear();
+    indentations.clear();
+    Frame frame{false, false};
+    const std::string *indentation = &no_indentation;
+    const Doc::Item *items = doc.items.data();
+    const size_t item_count = doc.items.size();
+    for (size_t i = 0; i < item_count; i++) {
+        const Doc::Item &item = items[i];
+        switch (item.kind) {
+        case Doc::Kind::Text:
+            drop_to(item.offset);
+            rewriter.keep(item.span_count);
+            column += item.width;
+            break;
+        case Doc::Kind::Line:
+        case Doc::Kind::SoftLine:
+        case Doc::Kind::HardLine: {
+            bool flat = frame.flat;
+            if (item.kind == Doc::Kind::HardLine) {
+                flat = false;
+            } else if (frame.is_fill && !frame.flat) {
+                flat = fits(column, (item.kind == Doc::Kind::Line) + width_to_line(doc, i + 1),
+                    column_limit);
+            }
+            // The whitespace this replaces goes first, so that its storage can be reused.
+            for (size_t j = i + 1; j < item_count; j++) {
+                if (items[j].kind == Doc::Kind::Text) {
+                    drop_to(items[j].offset);
+                    break;
+                }
+            }
+            if (!flat) {
+                rewriter.insert(SpanType::Newline, "\n");
+                rewriter.insert(SpanType::Space, *indentation);
+                column = indentation->size();
+            } else if (item.kind == Doc::Kind::Line) {
+                rewriter.insert(SpanType::Space, " ");
+                column += 1;
+            }
+            break;
+        }
+        case Doc::Kind::BeginGroup:
+            frames.push_back(frame);
+            frame = {false, frame.flat || fits(column, measures[i], column_limit)};
+            break;
+        case Doc::Kind::BeginFill:
+            frames.push_back(frame);
+            frame = {true, frame.flat};
+            break;
+        case Doc::Kind::EndGroup:
+        case Doc::Kind::EndFill:
+            frame = frames.back();
+            frames.pop_back();
+            break;
+        case Doc::Kind::BeginNest:
+            indentations.push_back(indentation);
+            indentation = item.indentation;
+            break;
+        case Doc::Kind::EndNest:
+            indentation = indentations.back();
+            indentations.pop_back();
+            break;
+        }
+    }
+}
+
+// An unquoted argument to a command in the tests below.
+struct TestArgument {
+    size_t offset;
+    size_t width;
+};
+
+// Prints the doc that build makes of the arguments of the command that input is, after the
+// command's opening paren and before its closing one.
+template <typename Build>
+static std::string print_arguments(const std::string &input, size_t column_limit, Build build) {
+    std::vector<Span> spans = parse(input);
+    {
+        SpanRewriter rewriter{spans};
+        size_t column = 0;
+        while (rewriter.ahead().type != SpanType::Lparen) {
+            column += rewriter.ahead().data.size();
+            rewriter.keep();
+        }
+        column += 1;
+        rewriter.keep();
+
+        std::vector<TestArgument> arguments;
+        for (size_t i = 0; rewriter.ahead(i).type != SpanType::Rparen; i++) {
+            if (rewriter.ahead(i).type == SpanType::Unquoted) {
+                arguments.push_back({i, rewriter.ahead(i).data.size()});
+            }
+        }
+        Doc doc;
+        build(doc, arguments);
+        print_doc(doc, rewriter, column, column_limit);
+    }
+    std::string output;
+    for (const auto &span : spans) {
+        output += span.data;
+    }
+    return output;
+}
+
+TEST_CASE("Breaks all of a group's lines or none") {
+    const std::string indentation = "  ";
+    auto build = [&](Doc &doc, const std::vector<TestArgument> &arguments) {
+        doc.begin_nest(indentation);
+        doc.begin_group();
+        for (size_t i = 0; i < arguments.size(); i++) {
+            if (i > 0) {
+                doc.line();
+            }
+            doc.text(arguments[i].offset, arguments[i].width);
+        }
+        doc.end_group();
+        doc.end_nest();
+    };
+    REQUIRE(print_arguments("command(AAA BBB CCC)", 20, build) == "command(AAA BBB CCC)");
+    REQUIRE(print_arguments("command(AAA BBB CCC)", 18, build) == "command(AAA\n  BBB\n  CCC)");
+}
+
+TEST_CASE("Counts what comes after a group up to the next line") {
+    auto build = [&](Doc &doc, const std::vector<TestArgument> &arguments) {
+        doc.begin_group();
+        doc.text(arguments[0].offset, arguments[0].width);
+        doc.line();
+        doc.text(arguments[1].offset, arguments[1].width);
+        doc.end_group();
+        doc.text(arguments[2].offset, arguments[2].width);
+        doc.line();
+        doc.text(arguments[3].offset, arguments[3].width);
+    };
+    REQUIRE(print_arguments("command(A B C D)", 12, build) == "command(A BC\nD)");
+    REQUIRE(print_arguments("command(A B C D)", 11, build) == "command(A\nBC\nD)");
+}
+
+TEST_CASE("Breaks a group with a hard line in it") {
+    auto build = [&](Doc &doc, const std::vector<TestArgument> &arguments) {
+        doc.begin_group();
+        doc.text(arguments[0].offset, arguments[0].width);
+        doc.line();
+        doc.text(arguments[1].offset, arguments[1].width);
+        doc.hard_line();
+        doc.text(arguments[2].offset, arguments[2].width);
+        doc.end_group();
+    };
+    REQUIRE(print_arguments("command(A B C)", 80, build) == "command(A\nB\nC)");
+}
+
+TEST_CASE("Breaks lines in a fill only where what follows doesn't fit") {
+    const std::string indentation = "    ";
+    auto build = [&](Doc &doc, const std::vector<TestArgument> &arguments) {
+        doc.begin_nest(indentation);
+        doc.begin_fill();
+        for (size_t i = 0; i < arguments.size(); i++) {
+            if (i > 0) {
+                doc.line();
+            } else {
+                doc.soft_line();
+            }
+            doc.text(arguments[i].offset, arguments[i].width);
+        }
+        doc.end_fill();
+        doc.end_nest();
+    };
+    REQUIRE(print_arguments("command(AAAA BBBB CCCC DDDD EEEE)", 21, build) ==
+            "command(AAAA BBBB\n    CCCC DDDD EEEE)");
+    REQUIRE(print_arguments("command(AAAAAAAAAAAAAA BBBB)", 20, build) ==
+            "command(\n    AAAAAAAAAAAAAA\n    BBBB)");
+}
+
+TEST_CASE("Lays out a fill in a group that fits without breaking it") {
+    auto build = [&](Doc &doc, const std::vector<TestArgument> &arguments) {
+        doc.begin_group();
+        doc.begin_fill();
+        doc.text(arguments[0].offset, arguments[0].width);
+        doc.line();
+        doc.text(arguments[1].offset, arguments[1].width);
+        doc.end_fill();
+        doc.end_group();
+    };
+    REQUIRE(print_arguments("command(A\n\n   B)", 80, build) == "command(A B)");
+}
@@ -0,0 +1,101 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// A document for laying out a command's arguments, in the style of Wadler's "A prettier
+// printer". The reflow transforms that have lines to choose between describe a command as a Doc
+// of its spans and the places where lines could break, and print_doc() decides which of them do,
+// so they don't count columns themselves.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "helpers.h"
+
+struct Doc {
+    enum class Kind {
+        // Spans of the input, kept as they are.
+        Text,
+        // A space, or a line break.
+        Line,
+        // Nothing, or a line break.
+        SoftLine,
+        // Always a line break.
+        HardLine,
+        // The lines directly inside a group all break, unless all of it fits on the line it
+        // starts on, together with whatever comes after it up to the next line.
+        BeginGroup,
+        EndGroup,
+        // Each line directly inside a fill breaks only if what comes after it, up to the next
+        // line, doesn't fit on the line otherwise.
+        BeginFill,
+        EndFill,
+        // Lines that break inside a nest start with its indentation, rather than none.
+        BeginNest,
+        EndNest,
+    };
+
+    struct Item {
+        Kind kind;
+        // For Text, how many spans it is, where they start counting from the rewriter's position
+        // when printing starts, and the columns they take up.
+        uint32_t span_count;
+        size_t offset;
+        size_t width;
+        // For BeginNest.
+        const std::string *indentation;
+    };
+
+    void clear() {
+        items.clear();
+        has_groups = false;
+    }
+    // span_count spans of the input, offset spans ahead of the rewriter. The spans between texts
+    // are spaces and newlines, which the lines between them stand in for. width can be more than
+    // the spans take up, to keep a margin after them.
+    void text(size_t offset, size_t width, size_t span_count = 1) {
+        items.push_back({Kind::Text, static_cast<uint32_t>(span_count), offset, width, nullptr});
+    }
+    void line() {
+        items.push_back({Kind::Line, 0, 0, 0, nullptr});
+    }
+    void soft_line() {
+        items.push_back({Kind::SoftLine, 0, 0, 0, nullptr});
+    }
+    void hard_line() {
+        items.push_back({Kind::HardLine, 0, 0, 0, nullptr});
+    }
+    void begin_group() {
+        items.push_back({Kind::BeginGroup, 0, 0, 0, nullptr});
+        has_groups = true;
+    }
+    void end_group() {
+        items.push_back({Kind::EndGroup, 0, 0, 0, nullptr});
+    }
+    void begin_fill() {
+        items.push_back({Kind::BeginFill, 0, 0, 0, nullptr});
+    }
+    void end_fill() {
+        items.push_back({Kind::EndFill, 0, 0, 0, nullptr});
+    }
+    // indentation has to outlive the Doc's printing.
+    void begin_nest(const std::string &indentation) {
+        items.push_back({Kind::BeginNest, 0, 0, 0, &indentation});
+    }
+    void end_nest() {
+        items.push_back({Kind::EndNest, 0, 0, 0, nullptr});
+    }
+
+    std::vector<Item> items;
+    // Only groups need measuring before printing.
+    bool has_groups = false;
+};
+
+// Prints doc at the rewriter's position, at column, keeping and dropping spans and inserting
+// spaces and newlines, so that lines fit in column_limit where they can. Each group and each line
+// in a fill is decided once, looking ahead no further than the next line; groups are measured in a
+// single pass beforehand. So the whole thing takes time linear in the size of doc.
+void print_doc(const Doc &doc, SpanRewriter &rewriter, size_t column, size_t column_limit);
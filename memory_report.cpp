@@ -0,0 +1,195 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+// windows.h first.
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "allocations.h"
+#include "helpers.h"
+#include "memory_report.h"
+
+#if defined(__linux__)
+
+ResidentMemory resident_memory() {
+    ResidentMemory memory{0, 0};
+    FILE *status = fopen("/proc/self/status", "r");
+    if (!status) {
+        return memory;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), status)) {
+        unsigned long long kilobytes;
+        if (sscanf(line, "VmRSS: %llu kB", &kilobytes) == 1) {
+            memory.current = static_cast<size_t>(kilobytes * 1024);
+        } else if (sscanf(line, "VmHWM: %llu kB", &kilobytes) == 1) {
+            memory.peak = static_cast<size_t>(kilobytes * 1024);
+        }
+    }
+    fclose(status);
+    return memory;
+}
+
+bool reset_peak_rss() {
+    // Since Linux 4.0, writing 5 here resets VmHWM to VmRSS.
+    FILE *clear_refs = fopen("/proc/self/clear_refs", "w");
+    if (!clear_refs) {
+        return false;
+    }
+    const bool ok = fputs("5", clear_refs) >= 0;
+    return fclose(clear_refs) == 0 && ok;
+}
+
+#elif defined(_WIN32)
+
+ResidentMemory resident_memory() {
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return {0, 0};
+    }
+    return {counters.WorkingSetSize, counters.PeakWorkingSetSize};
+}
+
+bool reset_peak_rss() {
+    return false;
+}
+
+#else
+
+ResidentMemory resident_memory() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return {0, 0};
+    }
+#ifdef __APPLE__
+    // In bytes on macOS, and kilobytes elsewhere.
+    return {0, static_cast<size_t>(usage.ru_maxrss)};
+#else
+    return {0, static_cast<size_t>(usage.ru_maxrss) * 1024};
+#endif
+}
+
+bool reset_peak_rss() {
+    return false;
+}
+
+#endif
+
+void MemoryReport::begin_file(const std::string &filename) {
+    files.emplace_back();
+    files.back().filename = filename;
+    reset_peak_heap();
+    if (!reset_peak_rss()) {
+        peak_rss_per_file = false;
+    }
+}
+
+void MemoryReport::end_file(size_t size, size_t chunks) {
+    FileMemory &file = files.back();
+    file.size = size;
+    file.chunks = chunks;
+    file.peak_heap = heap_usage().peak;
+    file.peak_rss = resident_memory().peak;
+}
+
+static std::string megabytes(size_t bytes) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f", bytes / (1024.0 * 1024.0));
+    return text;
+}
+
+void MemoryReport::write(std::ostream &out) const {
+    size_t name_width = std::string{"file"}.size();
+    for (const auto &file : files) {
+        name_width = std::max(name_width, file.filename.size());
+    }
+    name_width += 2;
+
+    std::vector<const FileMemory *> by_rss;
+    for (const auto &file : files) {
+        by_rss.push_back(&file);
+    }
+    std::stable_sort(by_rss.begin(), by_rss.end(), [](const FileMemory *a, const FileMemory *b) {
+        return a->peak_rss > b->peak_rss;
+    });
+
+    std::ostringstream text;
+    text << "Memory report for " << files.size() << " file(s)";
+    if (!counting_allocations()) {
+        text << "; heap only measured with CMAKEFORMAT_COUNT_ALLOCATIONS";
+    }
+    if (!peak_rss_per_file) {
+        text << "; peak RSS is over the run so far";
+    }
+    text << "\n\nfile" << repeat_string(" ", name_width - 4)
+         << "    size(MB)  heap(MB)  heap/byte   RSS(MB)  chunks\n";
+    const bool heap = counting_allocations();
+    for (const FileMemory *file : by_rss) {
+        char heap_per_byte[32] = "-";
+        if (heap && file->size > 0) {
+            snprintf(heap_per_byte, sizeof(heap_per_byte), "%.1f",
+                static_cast<double>(file->peak_heap) / file->size);
+        }
+        char numbers[128];
+        snprintf(numbers, sizeof(numbers), "%12s %9s %10s %9s %7s\n",
+            megabytes(file->size).c_str(), heap ? megabytes(file->peak_heap).c_str() : "-",
+            heap_per_byte, megabytes(file->peak_rss).c_str(),
+            file->chunks > 0 ? std::to_string(file->chunks).c_str() : "-");
+        text << file->filename << repeat_string(" ", name_width - file->filename.size())
+             << numbers;
+    }
+    out << text.str();
+}
+
+TEST_CASE("Reports memory by file") {
+    MemoryReport report;
+    report.files.resize(2);
+    report.files[0].filename = "a.cmake";
+    report.files[0].size = 1024 * 1024;
+    report.files[0].peak_heap = 20 * 1024 * 1024;
+    report.files[0].peak_rss = 30 * 1024 * 1024;
+    report.files[1].filename = "big.cmake";
+    report.files[1].size = 100 * 1024 * 1024;
+    report.files[1].peak_heap = 40 * 1024 * 1024;
+    report.files[1].peak_rss = 50 * 1024 * 1024;
+    report.files[1].chunks = 12;
+
+    std::ostringstream out;
+    report.write(out);
+    if (counting_allocations()) {
+        REQUIRE(out.str() ==
+                "Memory report for 2 file(s)\n"
+                "\n"
+                "file           size(MB)  heap(MB)  heap/byte   RSS(MB)  chunks\n"
+                "big.cmake         100.0      40.0        0.4      50.0      12\n"
+                "a.cmake             1.0      20.0       20.0      30.0       -\n");
+    }
+}
+
+TEST_CASE("Measures peak RSS") {
+    const ResidentMemory before = resident_memory();
+#ifdef __linux__
+    REQUIRE(before.current > 0);
+    REQUIRE(before.peak >= before.current);
+#endif
+    MemoryReport report;
+    report.begin_file("a.cmake");
+    {
+        std::vector<char> touched(16 * 1024 * 1024, 1);
+        REQUIRE(touched.back() == 1);
+    }
+    report.end_file(100, 0);
+    REQUIRE(report.files[0].peak_rss >= before.current);
+    if (counting_allocations()) {
+        REQUIRE(report.files[0].peak_heap >= 16 * 1024 * 1024);
+    }
+}
@@ -0,0 +1,46 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The process's resident set size, and the most it's been since the last reset_peak_rss(), in
+// bytes. Either is zero where the system doesn't say.
+struct ResidentMemory {
+    size_t current;
+    size_t peak;
+};
+ResidentMemory resident_memory();
+
+// Starts measuring the peak RSS from the current RSS. Returns false where that isn't possible,
+// which leaves the peak covering the whole run so far.
+bool reset_peak_rss();
+
+// Peak heap and RSS while formatting each file, for -memory-report.
+struct MemoryReport {
+    struct FileMemory {
+        std::string filename;
+        size_t size = 0;
+        size_t peak_heap = 0;
+        size_t peak_rss = 0;
+        // How many pieces the file was formatted in, if it was streamed; 0 if it was formatted
+        // all at once.
+        size_t chunks = 0;
+    };
+
+    // Starts measuring peaks for a new file.
+    void begin_file(const std::string &filename);
+    // Records the peaks since begin_file().
+    void end_file(size_t size, size_t chunks);
+
+    // Writes a table of the files, highest peak RSS first.
+    void write(std::ostream &out) const;
+
+    std::vector<FileMemory> files;
+    // Whether the peaks for each file are its own, rather than over the run so far.
+    bool peak_rss_per_file = true;
+};
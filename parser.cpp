@@ -2,7 +2,8 @@
    file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
    details.  */
 
-#include <cctype>
+#include <algorithm>
+#include <cstdint>
 
 #include "cmListFileLexer.h"
 #include "helpers.h"
@@ -11,43 +12,154 @@
 parseexception::parseexception(const std::string &message) : std::runtime_error{message} {
 }
 
-struct Lexer {
+ParseContext::ParseContext() {
+    lexer = cmListFileLexer_New();
+    if (!lexer) {
+        throw std::runtime_error("couldn't allocate cmListFileLexer");
+    }
+}
 
-    Lexer(const std::string &data) {
-        lexer = cmListFileLexer_New();
-        if (!lexer) {
-            throw std::runtime_error("couldn't allocate cmListFileLexer");
-        }
+ParseContext::~ParseContext() {
+    cmListFileLexer_Delete(lexer);
+}
 
+struct Lexer {
+
+    Lexer(cmListFileLexer *lexer_, const std::string &data_) : lexer{lexer_}, data(data_) {
         (void)cmListFileLexer_SetString(lexer, data.c_str());
         // TODO: handle result
 
         advance();
     }
     ~Lexer() {
-        cmListFileLexer_Delete(lexer);
+        (void)cmListFileLexer_SetString(lexer, nullptr);
     }
 
     void advance() {
         token = cmListFileLexer_Scan(lexer);
     }
 
+    // Byte offset of the current token, worked out from its line and column. Tokens only move
+    // forwards, so finding line starts costs a single pass over the input.
+    size_t offset() {
+        while (line < token->line) {
+            line_start = data.find('\n', line_start) + 1;
+            line++;
+        }
+        return line_start + token->column - 1;
+    }
+
+    // The source text of the current bracket argument or comment. The lexer only gives what's
+    // between the brackets.
+    std::string bracket_text() {
+        const size_t start = offset();
+        const size_t open = start + (data[start] == '#' ? 2 : 1);
+        const size_t equals = data.find_first_not_of('=', open) - open;
+        const std::string close = "]" + std::string(equals, '=') + "]";
+        const size_t end = data.find(close, open + equals + 1) + close.size();
+        return data.substr(start, end - start);
+    }
+
     cmListFileLexer_Token *token;
 
   private:
     cmListFileLexer *lexer;
+    const std::string &data;
+    int line = 1;
+    size_t line_start = 0;
+};
+
+// Classes of characters that classify_argument() looks for, as bits.
+enum : uint8_t {
+    UpperChar = 1 << 0,
+    LetterChar = 1 << 1,
+    SemicolonChar = 1 << 2,
+    SlashChar = 1 << 3,
+    DollarChar = 1 << 4,
+    LbraceChar = 1 << 5,
+    LessChar = 1 << 6,
+    DotChar = 1 << 7,
+};
+
+// Looked up rather than tested with <cctype>, which is slower.
+struct CharClasses {
+    CharClasses() : classes() {
+        for (int c = 0; c < 256; c++) {
+            if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-') {
+                classes[c] |= UpperChar;
+            }
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+                classes[c] |= LetterChar;
+            }
+        }
+        classes[static_cast<unsigned char>(';')] |= SemicolonChar;
+        classes[static_cast<unsigned char>('/')] |= SlashChar;
+        classes[static_cast<unsigned char>('$')] |= DollarChar;
+        classes[static_cast<unsigned char>('{')] |= LbraceChar;
+        classes[static_cast<unsigned char>('<')] |= LessChar;
+        classes[static_cast<unsigned char>('.')] |= DotChar;
+    }
+    uint8_t classes[256];
 };
 
+// Looks at each character of an argument once, through a table of character classes, combining
+// them without branching: those of all the characters, of any, and of any after a $ or a dot.
+// Every byte but the continuation bytes of UTF-8 takes a column.
+static ArgumentFlags classify_argument(const std::string &text) {
+    static const CharClasses table;
+    unsigned all = 0xff;
+    unsigned any = 0;
+    unsigned after_dollar = 0;
+    unsigned after_dot = 0;
+    unsigned previous = 0;
+    size_t display_width = 0;
+    for (char c : text) {
+        const unsigned classes = table.classes[static_cast<unsigned char>(c)];
+        all &= classes;
+        any |= classes;
+        after_dollar |= previous & DollarChar ? classes : 0;
+        after_dot |= previous & DotChar ? classes : 0;
+        previous = classes;
+        display_width += (static_cast<unsigned char>(c) & 0xc0) != 0x80;
+    }
+    ArgumentFlags flags = {};
+    flags.all_upper = (all & UpperChar) != 0;
+    flags.has_variable_reference = (after_dollar & LbraceChar) != 0;
+    flags.has_generator_expression = (after_dollar & LessChar) != 0;
+    flags.has_semicolon = (any & SemicolonChar) != 0;
+    flags.looks_like_path = (any & SlashChar) != 0 || (after_dot & LetterChar) != 0;
+    flags.display_width = std::min<size_t>(display_width, max_display_width);
+    return flags;
+}
+
+static void add_argument(
+    std::vector<Span> &spans, SpanType type, const std::string &text, size_t offset) {
+    spans.emplace_back(type, text, offset);
+    spans.back().flags = classify_argument(spans.back().data);
+}
+
+// Before adding a comment: marks the argument before it, if it's on the same line.
+static void mark_comment_follows(std::vector<Span> &spans) {
+    size_t i = spans.size();
+    if (i > 0 && spans[i - 1].type == SpanType::Space) {
+        i--;
+    }
+    if (i > 0 &&
+        (spans[i - 1].type == SpanType::Quoted || spans[i - 1].type == SpanType::Unquoted)) {
+        spans[i - 1].flags.comment_follows = true;
+    }
+}
+
 void skip_whitespace(std::vector<Span> &spans, Lexer &lexer) {
     while (true) {
         if (!lexer.token) {
             break;
         } else if (cmListFileLexer_Token_Space == lexer.token->type) {
-            spans.emplace_back(SpanType::Space, lexer.token->text);
+            spans.emplace_back(SpanType::Space, lexer.token->text, lexer.offset());
             lexer.advance();
 
         } else if (cmListFileLexer_Token_Newline == lexer.token->type) {
-            spans.emplace_back(SpanType::Newline, lexer.token->text);
+            spans.emplace_back(SpanType::Newline, lexer.token->text, lexer.offset());
             lexer.advance();
             // HACK: Make sure newlines are always followed by whitespace, this makes
             // transformations easier.
@@ -56,7 +168,13 @@ void skip_whitespace(std::vector<Span> &spans, Lexer &lexer) {
             }
 
         } else if (cmListFileLexer_Token_Comment == lexer.token->type) {
-            spans.emplace_back(SpanType::Comment, lexer.token->text);
+            mark_comment_follows(spans);
+            spans.emplace_back(SpanType::Comment, lexer.token->text, lexer.offset());
+            lexer.advance();
+
+        } else if (cmListFileLexer_Token_CommentBracket == lexer.token->type) {
+            mark_comment_follows(spans);
+            spans.emplace_back(SpanType::Comment, lexer.bracket_text(), lexer.offset());
             lexer.advance();
 
         } else {
@@ -83,7 +201,7 @@ void expecttokentype(const std::string &description, const cmListFileLexer_Token
 
 void parse_argument(std::vector<Span> &spans, Lexer &lexer) {
     if (lexer.token && lexer.token->type == cmListFileLexer_Token_ParenLeft) {
-        spans.emplace_back(SpanType::Lparen, lexer.token->text);
+        spans.emplace_back(SpanType::Lparen, lexer.token->text, lexer.offset());
         lexer.advance();
 
         while (true) {
@@ -94,30 +212,35 @@ void parse_argument(std::vector<Span> &spans, Lexer &lexer) {
                     // transformations easier.
                     spans.emplace_back(SpanType::Space, "");
                 }
-                spans.emplace_back(SpanType::Rparen, lexer.token->text);
+                spans.emplace_back(SpanType::Rparen, lexer.token->text, lexer.offset());
                 lexer.advance();
                 break;
             }
             parse_argument(spans, lexer);
         }
     } else if (lexer.token && lexer.token->type == cmListFileLexer_Token_Identifier) {
-        spans.emplace_back(SpanType::Unquoted, lexer.token->text);
+        add_argument(spans, SpanType::Unquoted, lexer.token->text, lexer.offset());
         lexer.advance();
     } else if (lexer.token && lexer.token->type == cmListFileLexer_Token_ArgumentUnquoted) {
-        spans.emplace_back(SpanType::Unquoted, lexer.token->text);
+        add_argument(spans, SpanType::Unquoted, lexer.token->text, lexer.offset());
         lexer.advance();
     } else if (lexer.token && lexer.token->type == cmListFileLexer_Token_ArgumentQuoted) {
-        spans.emplace_back(SpanType::Quoted, "\"" + std::string{lexer.token->text} + "\"");
+        add_argument(
+            spans, SpanType::Quoted, "\"" + std::string{lexer.token->text} + "\"", lexer.offset());
+        lexer.advance();
+    } else if (lexer.token && lexer.token->type == cmListFileLexer_Token_ArgumentBracket) {
+        // Like a quoted argument, it's a single argument that can't be split.
+        add_argument(spans, SpanType::Quoted, lexer.bracket_text(), lexer.offset());
         lexer.advance();
     } else {
         expecttokentype("argument or rparen", lexer.token, {});
     }
 }
 
-std::vector<Span> parse(const std::string &content) {
-    std::vector<Span> spans;
+void parse(const std::string &content, std::vector<Span> &spans, ParseContext &context) {
+    spans.clear();
 
-    Lexer lexer{content};
+    Lexer lexer{context.lexer, content};
 
     while (true) {
         skip_whitespace(spans, lexer);
@@ -134,29 +257,92 @@ std::vector<Span> parse(const std::string &content) {
         if (spans.size() == 0 || spans.back().type != SpanType::Space) {
             spans.emplace_back(SpanType::Space, "");
         }
-        spans.emplace_back(SpanType::CommandIdentifier, lexer.token->text);
+        spans.emplace_back(SpanType::CommandIdentifier, lexer.token->text, lexer.offset());
         lexer.advance();
 
         skip_whitespace(spans, lexer);
 
         expecttokentype("whitespace or left paren", lexer.token, {cmListFileLexer_Token_ParenLeft});
-        spans.emplace_back(SpanType::Lparen, lexer.token->text);
+        spans.emplace_back(SpanType::Lparen, lexer.token->text, lexer.offset());
         lexer.advance();
 
         while (true) {
             skip_whitespace(spans, lexer);
             if (lexer.token && lexer.token->type == cmListFileLexer_Token_ParenRight) {
-                spans.emplace_back(SpanType::Rparen, lexer.token->text);
+                spans.emplace_back(SpanType::Rparen, lexer.token->text, lexer.offset());
                 lexer.advance();
                 break;
             }
             parse_argument(spans, lexer);
         }
     }
+}
 
+std::vector<Span> parse(const std::string &content) {
+    std::vector<Span> spans;
+    ParseContext context;
+    parse(content, spans, context);
     return spans;
 }
 
+size_t find_last_split(const std::string &content, ParseContext &context) {
+    Lexer lexer{context.lexer, content};
+    size_t split = 0;
+    int paren_depth = 0;
+    // Counted the way transform_indent() counts it.
+    int block_depth = 0;
+    // Whether there's been nothing but whitespace since a command's closing paren.
+    bool after_command = false;
+    // Where the current line starts, if there's been nothing but whitespace on it so far.
+    size_t line_start = std::string::npos;
+    std::string ident;
+    for (; lexer.token; lexer.advance()) {
+        switch (lexer.token->type) {
+        case cmListFileLexer_Token_Space:
+            continue;
+        case cmListFileLexer_Token_Newline:
+            line_start = lexer.offset() + 1;
+            continue;
+        case cmListFileLexer_Token_Identifier:
+            if (paren_depth == 0) {
+                if (after_command && line_start != std::string::npos && block_depth == 0) {
+                    split = line_start;
+                }
+                lowercase_into(ident, lexer.token->text);
+                if (ident == "if" || ident == "foreach" || ident == "while" || ident == "macro" ||
+                    ident == "function") {
+                    block_depth++;
+                } else if (ident == "endif" || ident == "endforeach" || ident == "endwhile" ||
+                           ident == "endmacro" || ident == "endfunction") {
+                    block_depth--;
+                }
+            }
+            break;
+        case cmListFileLexer_Token_ParenLeft:
+            paren_depth++;
+            break;
+        case cmListFileLexer_Token_ParenRight:
+            paren_depth--;
+            if (paren_depth == 0) {
+                after_command = true;
+                line_start = std::string::npos;
+                continue;
+            }
+            break;
+        case cmListFileLexer_Token_BadCharacter:
+        case cmListFileLexer_Token_BadBracket:
+        case cmListFileLexer_Token_BadString:
+            // Maybe just cut short; either way, nothing after this can be trusted.
+            return split;
+        default:
+            break;
+        }
+        after_command = false;
+        line_start = std::string::npos;
+    }
+    return split;
+}
+
 TEST_CASE("Parses CMake code") {
     REQUIRE_PARSES(R"(
 cmake_command_without_arguments()
@@ -185,6 +371,61 @@ simple_cmake_command(
 )");
 }
 
+TEST_CASE("Records where spans came from") {
+    const std::string content = "a()\n  b(ARG \"quoted\n string\" # comment\n\t)\n";
+    ParseContext context;
+    std::vector<Span> spans;
+    for (int i = 0; i < 2; i++) {
+        parse(content, spans, context);
+        for (const auto &s : spans) {
+            if (s.offset == std::string::npos) {
+                REQUIRE(s.data == "");
+            } else {
+                REQUIRE(content.substr(s.offset, s.data.size()) == s.data);
+            }
+        }
+    }
+}
+
+TEST_CASE("Classifies arguments") {
+    const std::vector<Span> spans =
+        parse("c(PUBLIC src/a.cpp ${V} $<C:x> a;b \"Q\" # comment\n  3.0 X #[[b]]\n"
+              "  h\xc3\xa9 \"\xe2\x82\xac\")");
+    std::vector<ArgumentFlags> flags;
+    for (const auto &s : spans) {
+        if (s.type == SpanType::Quoted || s.type == SpanType::Unquoted) {
+            flags.push_back(s.flags);
+        }
+    }
+    REQUIRE(flags.size() == 10);
+    REQUIRE((flags[0].all_upper && !flags[0].comment_follows));
+    REQUIRE((!flags[1].all_upper && flags[1].looks_like_path));
+    REQUIRE((flags[2].has_variable_reference && !flags[2].has_generator_expression));
+    REQUIRE((flags[3].has_generator_expression && !flags[3].has_variable_reference));
+    REQUIRE((!flags[3].has_semicolon && !flags[3].looks_like_path));
+    REQUIRE((flags[4].has_semicolon && !flags[4].looks_like_path));
+    REQUIRE((!flags[5].all_upper && flags[5].comment_follows));
+    REQUIRE((!flags[6].all_upper && !flags[6].looks_like_path && !flags[6].comment_follows));
+    REQUIRE(flags[7].comment_follows);
+    REQUIRE(flags[1].display_width == 9);
+    REQUIRE(flags[5].display_width == 3);
+    // Two bytes of UTF-8 for the é, and three for the €.
+    REQUIRE(flags[8].display_width == 2);
+    REQUIRE(flags[9].display_width == 3);
+}
+
+TEST_CASE("Reuses a parse context") {
+    ParseContext context;
+    std::vector<Span> spans;
+    REQUIRE_THROWS(parse("unbalanced(", spans, context));
+    parse("first()", spans, context);
+    REQUIRE(spans.size() == 4);
+    parse("second(ARG)\n", spans, context);
+    REQUIRE(spans.size() == 7);
+    REQUIRE(spans[1].data == "second");
+    REQUIRE(spans[3].data == "ARG");
+}
+
 TEST_CASE("Doesn't hang on unbalanced parentheses") {
     REQUIRE_THROWS(parse(R"(command()"));
 }
@@ -192,3 +433,43 @@ TEST_CASE("Doesn't hang on unbalanced parentheses") {
 TEST_CASE("Parses bare parentheses in arguments") {
     REQUIRE_PARSES("simple_cmake_command(some (bare (parentheses)) here)");
 }
+
+TEST_CASE("Parses bracket arguments and comments") {
+    // The lexer only sees a bracket comment if the bracket is followed by a newline; otherwise
+    // it's a line comment.
+    const std::string content = "#[[\nbracket\ncomment]] command([[bracket]] [==[with ]] and\n"
+                                "]=] inside]==] after) #[=[\n]=]\nnext([[]]) #[[ line ]] comment\n";
+    REQUIRE_PARSES(content);
+    const std::vector<Span> spans = parse(content);
+    REQUIRE(spans[0].type == SpanType::Comment);
+    REQUIRE(spans[0].data == "#[[\nbracket\ncomment]]");
+    REQUIRE(spans[4].type == SpanType::Quoted);
+    REQUIRE(spans[4].data == "[[bracket]]");
+    REQUIRE(spans[6].type == SpanType::Quoted);
+    REQUIRE(spans[6].data == "[==[with ]] and\n]=] inside]==]");
+    REQUIRE(spans[8].data == "after");
+    REQUIRE(spans[spans.size() - 3].data == "#[[ line ]] comment");
+    for (const auto &s : spans) {
+        if (s.offset != std::string::npos) {
+            REQUIRE(content.substr(s.offset, s.data.size()) == s.data);
+        }
+    }
+    REQUIRE_THROWS(parse("command([[unterminated)"));
+}
+
+TEST_CASE("Finds where to split input") {
+    ParseContext context;
+    REQUIRE(find_last_split("", context) == 0);
+    REQUIRE(find_last_split("a()\n", context) == 0);
+    REQUIRE(find_last_split("a()\nb()\n", context) == 4);
+    REQUIRE(find_last_split("a()\n\n  b()\nc(\n)\n", context) == 11);
+    // Not inside blocks, or in front of the comments before a command, which are indented
+    // along with the command.
+    REQUIRE(find_last_split("a()\nIF(A)\n  b()\nendif()\nc()\n", context) == 24);
+    REQUIRE(find_last_split("a()\n# comment\nb()\n", context) == 0);
+    REQUIRE(find_last_split("a() # comment\nb()\n", context) == 0);
+    // Not inside strings or bracket arguments.
+    REQUIRE(find_last_split("a(\"\nb()\n\")\nc([[\n]]\n)\n", context) == 11);
+    // Only before what's been cut short.
+    REQUIRE(find_last_split("a()\nb()\nc(\"unterminated\nd()\n", context) == 8);
+}
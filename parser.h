@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -19,15 +21,62 @@ enum class SpanType {
     Rparen,
 };
 
+// The most columns ArgumentFlags::display_width counts; wider arguments are taken to be this wide.
+static constexpr size_t max_display_width = (1 << 24) - 1;
+
+// What parse() finds in the text of an argument as it reads it, so that transforms don't have to
+// look through the text again. Spans that parse() didn't make have none of these set. Bit-fields
+// fit in the padding after a Span's type, so spans don't get any bigger.
+struct ArgumentFlags {
+    // Like PUBLIC or DESTINATION: only uppercase letters, digits, underscores and dashes.
+    bool all_upper : 1;
+    bool has_variable_reference : 1;
+    bool has_generator_expression : 1;
+    bool has_semicolon : 1;
+    // Has a slash, or a dot followed by a letter, like src/main.cpp.
+    bool looks_like_path : 1;
+    // There's a comment after it on the same line.
+    bool comment_follows : 1;
+    // How many columns it takes: a character of UTF-8 takes one, however many bytes it is.
+    uint32_t display_width : 24;
+};
+static_assert(sizeof(ArgumentFlags) == sizeof(SpanType), "flags fit after a Span's type");
+
 struct Span {
-    Span(const SpanType &type_, const std::string &data_) : type(type_), data(data_) {
+    Span(const SpanType &type_, const std::string &data_, size_t offset_ = std::string::npos)
+        : type(type_), data(data_), offset(offset_) {
     }
     SpanType type;
+    // For quoted and unquoted arguments.
+    ArgumentFlags flags = {};
     std::string data;
+    // Byte offset of data in the parsed input, or npos for spans that don't come from the input.
+    // Transforms that change data in place leave this alone.
+    size_t offset;
 };
 
 struct parseexception : public std::runtime_error {
     explicit parseexception(const std::string &message);
 };
 
+struct cmListFileLexer_s;
+
+// Owns a lexer that can be reused by many calls to parse().
+struct ParseContext {
+    ParseContext();
+    ~ParseContext();
+    ParseContext(const ParseContext &) = delete;
+    ParseContext &operator=(const ParseContext &) = delete;
+
+    cmListFileLexer_s *lexer;
+};
+
+// Replaces the contents of spans, keeping its capacity.
+void parse(const std::string &content, std::vector<Span> &spans, ParseContext &context);
 std::vector<Span> parse(const std::string &content);
+
+// Where content can be cut in two so that formatting each part on its own gives the same result
+// as formatting the whole: the start of the last line that begins a command, outside any block,
+// right after the end of another command. 0 if there's nowhere, including in content that ends
+// partway through a token.
+size_t find_last_split(const std::string &content, ParseContext &context);
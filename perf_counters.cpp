@@ -0,0 +1,130 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perf_counters.h"
+
+const char *counter_name(PerfCounters::Counter counter) {
+    switch (counter) {
+    case PerfCounters::Cycles:
+        return "cycles";
+    case PerfCounters::Instructions:
+        return "instructions";
+    case PerfCounters::L1DataMisses:
+        return "L1 data misses";
+    case PerfCounters::LastLevelCacheMisses:
+        return "LLC misses";
+    case PerfCounters::BranchMisses:
+        return "branch misses";
+    }
+    return "?";
+}
+
+#ifdef __linux__
+
+static int open_counter(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // This thread, on any CPU, in no group.
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+PerfCounters::PerfCounters() {
+    const uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[counter_count] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, l1d_read_miss},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+    for (size_t i = 0; i < counter_count; i++) {
+        fds[i] = open_counter(events[i].type, events[i].config);
+        if (fds[i] < 0 && error.empty()) {
+            error = std::string{"can't count "} + counter_name(static_cast<Counter>(i)) +
+                    ": perf_event_open: " + strerror(errno);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void PerfCounters::start() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+PerfCounters::Counts PerfCounters::stop() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    Counts counts;
+    for (size_t i = 0; i < counter_count; i++) {
+        // The count, then the time the counter was enabled and the time it was really running.
+        uint64_t data[3];
+        counts.valid[i] = fds[i] >= 0 && read(fds[i], data, sizeof(data)) == sizeof(data) &&
+                          data[2] > 0;
+        counts.values[i] = counts.valid[i] ? static_cast<double>(data[0]) * data[1] / data[2] : 0;
+    }
+    return counts;
+}
+
+#else
+
+PerfCounters::PerfCounters() : error{"hardware counters are only read on Linux"} {
+    fds.fill(-1);
+}
+
+PerfCounters::~PerfCounters() {
+}
+
+void PerfCounters::start() {
+}
+
+PerfCounters::Counts PerfCounters::stop() {
+    Counts counts;
+    counts.values.fill(0);
+    counts.valid.fill(false);
+    return counts;
+}
+
+#endif
+
+bool PerfCounters::any_available() const {
+    return std::any_of(fds.begin(), fds.end(), [](int fd) { return fd >= 0; });
+}
@@ -0,0 +1,41 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+// Hardware performance counters for the calling thread, read through perf_event_open on Linux.
+// Counters the kernel won't give us, as in most containers, under a strict perf_event_paranoid,
+// in some VMs and on other systems, are just unavailable; the rest still work.
+struct PerfCounters {
+    enum Counter { Cycles, Instructions, L1DataMisses, LastLevelCacheMisses, BranchMisses };
+    static constexpr size_t counter_count = 5;
+
+    struct Counts {
+        // Scaled up if the kernel had to share the hardware between counters.
+        std::array<double, counter_count> values;
+        std::array<bool, counter_count> valid;
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool any_available() const;
+    // Starts counting from zero.
+    void start();
+    // Stops counting, and returns the counts since start().
+    Counts stop();
+
+    // Why the first unavailable counter is unavailable, or empty if they all work.
+    std::string error;
+    // -1 for unavailable counters.
+    std::array<int, counter_count> fds;
+};
+
+const char *counter_name(PerfCounters::Counter counter);
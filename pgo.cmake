@@ -0,0 +1,117 @@
+# Builds cmake-format with profile-guided optimization, for the pgo and pgo-bench targets:
+#
+#   cmake -DSOURCE_DIR=... -DPGO_DIR=... -DCORPUS_TOOL=... [-DBENCH=ON] -P pgo.cmake
+#
+# 1. builds an instrumented cmake-format in PGO_DIR/build,
+# 2. trains it on a corpus generated by CORPUS_TOOL, with each way of reflowing arguments,
+# 3. rebuilds it there with the profile, leaving the result in PGO_DIR/build.
+#
+# With BENCH, it also builds cmake-format-bench at plain -O2 (PGO_DIR/o2) and with LTO alone
+# (PGO_DIR/lto), and compares the three with COMPARE_TOOL.
+#
+# GCC names profiles after the object files they're for, so both stages of a build share a
+# directory.
+
+cmake_minimum_required(VERSION 3.0)
+
+foreach(variable SOURCE_DIR PGO_DIR CORPUS_TOOL)
+    if(NOT DEFINED ${variable})
+        message(FATAL_ERROR "pgo.cmake: ${variable} is not set")
+    endif()
+endforeach()
+
+set(configure_arguments -G "${GENERATOR}")
+foreach(variable CMAKE_C_COMPILER CMAKE_CXX_COMPILER CMAKE_MAKE_PROGRAM)
+    if(${variable})
+        list(APPEND configure_arguments "-D${variable}=${${variable}}")
+    endif()
+endforeach()
+
+function(run)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        string(REPLACE ";" " " command "${ARGN}")
+        message(FATAL_ERROR "pgo.cmake: '${command}' failed: ${result}")
+    endif()
+endfunction()
+
+# Configures SOURCE_DIR in Release into DIRECTORY with the remaining arguments, and builds TARGETS.
+function(build directory targets)
+    file(MAKE_DIRECTORY ${directory})
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} ${configure_arguments} -DCMAKE_BUILD_TYPE=Release ${ARGN}
+            ${SOURCE_DIR}
+        WORKING_DIRECTORY ${directory}
+        RESULT_VARIABLE result
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "pgo.cmake: configuring ${directory} failed")
+    endif()
+    foreach(target ${targets})
+        run(${CMAKE_COMMAND} --build ${directory} --target ${target})
+    endforeach()
+endfunction()
+
+set(build_dir ${PGO_DIR}/build)
+set(profile_dir ${PGO_DIR}/profile)
+set(corpus_dir ${PGO_DIR}/corpus)
+
+message(STATUS "Building instrumented cmake-format")
+file(REMOVE_RECURSE ${profile_dir})
+build(${build_dir} cmake-format -DCMAKEFORMAT_PGO=generate
+    -DCMAKEFORMAT_PGO_PROFILE_DIR=${profile_dir})
+
+message(STATUS "Training on ${corpus_dir}")
+file(MAKE_DIRECTORY ${corpus_dir})
+run(${CORPUS_TOOL} -directory=${corpus_dir} -count=20 -size=65536)
+file(GLOB corpus ${corpus_dir}/*.cmake)
+set(cmake_format ${build_dir}/cmake-format${CMAKE_EXECUTABLE_SUFFIX})
+foreach(reflow none oneperline binpack heuristic)
+    execute_process(COMMAND ${cmake_format} -reflow-arguments=${reflow} ${corpus}
+        OUTPUT_FILE ${PGO_DIR}/trained.cmake RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "pgo.cmake: training with -reflow-arguments=${reflow} failed")
+    endif()
+endforeach()
+run(${cmake_format} -reflow-arguments=binpack -column-limit=60 -command-case=upper
+    -space-before-parens=controlstatements -max-empty-lines-to-keep=0 ${corpus}
+    OUTPUT_FILE ${PGO_DIR}/trained.cmake)
+file(REMOVE ${PGO_DIR}/trained.cmake)
+
+if(CXX_COMPILER_ID MATCHES Clang)
+    file(GLOB raw_profiles ${profile_dir}/*.profraw)
+    find_program(LLVM_PROFDATA NAMES llvm-profdata
+        HINTS ${LLVM_PROFDATA_DIR} ENV LLVM_PROFDATA_DIR)
+    if(NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "pgo.cmake: llvm-profdata, to merge Clang profiles, is not found")
+    endif()
+    run(${LLVM_PROFDATA} merge -output=${profile_dir}/merged.profdata ${raw_profiles})
+endif()
+
+message(STATUS "Rebuilding cmake-format with the profile")
+set(bench_targets)
+if(BENCH)
+    set(bench_targets cmake-format-bench)
+endif()
+build(${build_dir} "cmake-format;${bench_targets}" -DCMAKEFORMAT_PGO=use)
+message(STATUS "Built ${cmake_format}")
+
+if(NOT BENCH)
+    return()
+endif()
+
+message(STATUS "Building cmake-format-bench at -O2, and with LTO")
+build(${PGO_DIR}/o2 cmake-format-bench -DCMAKEFORMAT_PGO= -DCMAKEFORMAT_LTO=OFF
+    "-DCMAKE_CXX_FLAGS_RELEASE=-O2 -DNDEBUG" "-DCMAKE_C_FLAGS_RELEASE=-O2 -DNDEBUG")
+build(${PGO_DIR}/lto cmake-format-bench -DCMAKEFORMAT_PGO= -DCMAKEFORMAT_LTO=ON)
+
+# Interleaved, so that the machine getting busier or quieter favours none of them. The first
+# round only warms up.
+foreach(round warmup timed)
+    foreach(build o2 lto build)
+        run(${PGO_DIR}/${build}/cmake-format-bench${CMAKE_EXECUTABLE_SUFFIX}
+            -json-file=${PGO_DIR}/${build}.json OUTPUT_QUIET)
+    endforeach()
+endforeach()
+file(RENAME ${PGO_DIR}/build.json ${PGO_DIR}/lto+pgo.json)
+run(${COMPARE_TOOL} ${PGO_DIR}/o2.json ${PGO_DIR}/lto.json ${PGO_DIR}/lto+pgo.json)
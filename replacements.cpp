@@ -0,0 +1,167 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <cstdio>
+#include <sstream>
+
+#include "helpers.h"
+#include "replacements.h"
+#include "transform.h"
+
+// Trims the text that an edit would leave unchanged off both of its ends.
+static void add_replacement(const std::string &original, size_t offset, size_t length,
+    const std::string &text, std::vector<Replacement> &replacements) {
+    size_t prefix = 0;
+    while (prefix < length && prefix < text.size() && original[offset + prefix] == text[prefix]) {
+        prefix++;
+    }
+    size_t suffix = 0;
+    while (suffix < length - prefix && suffix < text.size() - prefix &&
+           original[offset + length - 1 - suffix] == text[text.size() - 1 - suffix]) {
+        suffix++;
+    }
+    if (prefix + suffix == length && prefix + suffix == text.size()) {
+        return;
+    }
+    replacements.push_back(Replacement{offset + prefix, length - prefix - suffix,
+        text.substr(prefix, text.size() - prefix - suffix)});
+}
+
+void compute_replacements(const std::string &original, const std::vector<Span> &spans,
+    std::vector<Replacement> &replacements) {
+    replacements.clear();
+
+    // Everything before original_pos has been accounted for; pending holds the new text that
+    // replaces the original bytes from original_pos up to the next unchanged span.
+    size_t original_pos = 0;
+    std::string pending;
+    for (const auto &s : spans) {
+        const bool unchanged = s.offset != std::string::npos && s.offset >= original_pos &&
+                               !s.data.empty() &&
+                               original.compare(s.offset, s.data.size(), s.data) == 0;
+        if (!unchanged) {
+            pending += s.data;
+            continue;
+        }
+        add_replacement(original, original_pos, s.offset - original_pos, pending, replacements);
+        pending.clear();
+        original_pos = s.offset + s.data.size();
+    }
+    add_replacement(original, original_pos, original.size() - original_pos, pending, replacements);
+}
+
+static void write_xml_escaped(std::ostream &out, const std::string &text) {
+    for (char c : text) {
+        if (c == '&') {
+            out << "&amp;";
+        } else if (c == '<') {
+            out << "&lt;";
+        } else if (c == '\n' || c == '\r') {
+            out << "&#" << int(c) << ';';
+        } else {
+            out << c;
+        }
+    }
+}
+
+void write_replacements(
+    std::ostream &out, ReplacementsFormat format, const std::vector<Replacement> &replacements) {
+    if (format == ReplacementsFormat::Xml) {
+        out << "<?xml version='1.0'?>\n"
+               "<replacements xml:space='preserve' incomplete_format='false'>\n";
+        for (const auto &r : replacements) {
+            out << "<replacement offset='" << r.offset << "' length='" << r.length << "'>";
+            write_xml_escaped(out, r.text);
+            out << "</replacement>\n";
+        }
+        out << "</replacements>\n";
+    } else {
+        out << "[";
+        for (size_t i = 0; i < replacements.size(); i++) {
+            out << (i == 0 ? "\n" : ",\n") << "  {\"offset\": " << replacements[i].offset
+                << ", \"length\": " << replacements[i].length << ", \"text\": \"";
+            write_json_escaped(out, replacements[i].text);
+            out << "\"}";
+        }
+        out << (replacements.empty() ? "]\n" : "\n]\n");
+    }
+}
+
+static inline std::string apply_replacements(
+    std::string content, const std::vector<Replacement> &replacements) {
+    for (auto it = replacements.rbegin(); it != replacements.rend(); ++it) {
+        content.replace(it->offset, it->length, it->text);
+    }
+    return content;
+}
+
+static inline void REQUIRE_REPLACEMENTS_REPRODUCE(
+    const std::string &original, const std::vector<Span> &spans) {
+    std::string formatted;
+    for (const auto &s : spans) {
+        formatted += s.data;
+    }
+    std::vector<Replacement> replacements;
+    compute_replacements(original, spans, replacements);
+    REQUIRE(apply_replacements(original, replacements) == formatted);
+}
+
+TEST_CASE("Computes minimal replacements") {
+    const std::string original = "IF(A)\n        command(ARG1   ARG2)\nendif(A)\n";
+    std::vector<Span> spans = parse(original);
+    transform_indent(spans, "  ");
+    transform_loosen_loop_constructs(spans);
+    transform_command_case(spans, LetterCase::Lower);
+    REQUIRE_REPLACEMENTS_REPRODUCE(original, spans);
+
+    std::vector<Replacement> replacements;
+    compute_replacements(original, spans, replacements);
+    REQUIRE(replacements.size() == 3);
+    REQUIRE(replacements[0].offset == 0);
+    REQUIRE(replacements[0].length == 2);
+    REQUIRE(replacements[0].text == "if");
+    REQUIRE(replacements[1].offset == 8);
+    REQUIRE(replacements[1].length == 6);
+    REQUIRE(replacements[1].text == "");
+    REQUIRE(replacements[2].offset == 41);
+    REQUIRE(replacements[2].length == 1);
+    REQUIRE(replacements[2].text == "");
+}
+
+TEST_CASE("Computes no replacements for formatted input") {
+    const std::string original = "if(A)\n    command(ARG)\nendif()\n";
+    std::vector<Span> spans = parse(original);
+    transform_indent(spans, "    ");
+    std::vector<Replacement> replacements;
+    compute_replacements(original, spans, replacements);
+    REQUIRE(replacements.empty());
+}
+
+TEST_CASE("Computes replacements for reflowed arguments") {
+    const std::string original = "command(\"quoted\"   ARG # comment\n  ARG2 ARG3 ARG4)\n";
+    std::vector<Span> spans = parse(original);
+    transform_argument_bin_pack(spans, 20, "  ");
+    REQUIRE_REPLACEMENTS_REPRODUCE(original, spans);
+
+    spans = parse(original);
+    transform_argument_per_line(spans, "  ");
+    REQUIRE_REPLACEMENTS_REPRODUCE(original, spans);
+}
+
+TEST_CASE("Writes replacements") {
+    const std::vector<Replacement> replacements = {{1, 2, "a\n\"<&"}, {5, 0, ""}};
+    std::ostringstream json;
+    write_replacements(json, ReplacementsFormat::Json, replacements);
+    REQUIRE(json.str() == "[\n"
+                          "  {\"offset\": 1, \"length\": 2, \"text\": \"a\\n\\\"<&\"},\n"
+                          "  {\"offset\": 5, \"length\": 0, \"text\": \"\"}\n"
+                          "]\n");
+    std::ostringstream xml;
+    write_replacements(xml, ReplacementsFormat::Xml, replacements);
+    REQUIRE(xml.str() == "<?xml version='1.0'?>\n"
+                         "<replacements xml:space='preserve' incomplete_format='false'>\n"
+                         "<replacement offset='1' length='2'>a&#10;\"&lt;&amp;</replacement>\n"
+                         "<replacement offset='5' length='0'></replacement>\n"
+                         "</replacements>\n");
+}
@@ -0,0 +1,33 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "parser.h"
+
+// Replace length bytes at offset in the original input with text.
+struct Replacement {
+    size_t offset;
+    size_t length;
+    std::string text;
+};
+
+enum class ReplacementsFormat {
+    Json,
+    Xml,
+};
+
+// Works out the edits that turn original into the concatenation of spans, where spans were
+// parsed from original and then transformed. Spans that still hold their original text are
+// left alone, so the work done is proportional to the number of spans plus the size of the
+// changes, not to the size of the input.
+void compute_replacements(const std::string &original, const std::vector<Span> &spans,
+    std::vector<Replacement> &replacements);
+
+void write_replacements(
+    std::ostream &out, ReplacementsFormat format, const std::vector<Replacement> &replacements);
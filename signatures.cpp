@@ -0,0 +1,285 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <cstdlib>
+
+#include "helpers.h"
+#include "signatures.h"
+#include "traversal.h"
+
+struct BuiltinSignature {
+    const char *command;
+    uint32_t positional;
+    const char *options;
+    const char *one_value_keywords;
+    const char *multi_value_keywords;
+};
+
+// As in the CMake documentation, leaving out keywords that are only for the command's less used
+// forms where they'd be mistaken for values in its usual ones.
+static constexpr BuiltinSignature builtin_signatures[] = {
+    {"add_custom_command", 0,
+        "APPEND;VERBATIM;USES_TERMINAL;COMMAND_EXPAND_LISTS;PRE_BUILD;PRE_LINK;POST_BUILD",
+        "MAIN_DEPENDENCY;WORKING_DIRECTORY;COMMENT;DEPFILE;JOB_POOL;TARGET",
+        "OUTPUT;COMMAND;ARGS;DEPENDS;BYPRODUCTS;IMPLICIT_DEPENDS"},
+    {"add_custom_target", 1, "ALL;VERBATIM;USES_TERMINAL;COMMAND_EXPAND_LISTS",
+        "WORKING_DIRECTORY;COMMENT;JOB_POOL", "COMMAND;DEPENDS;BYPRODUCTS;SOURCES"},
+    {"add_executable", 1, "WIN32;MACOSX_BUNDLE;EXCLUDE_FROM_ALL;IMPORTED;GLOBAL", "ALIAS", ""},
+    {"add_library", 1,
+        "STATIC;SHARED;MODULE;OBJECT;INTERFACE;UNKNOWN;EXCLUDE_FROM_ALL;IMPORTED;GLOBAL", "ALIAS",
+        ""},
+    {"add_subdirectory", 1, "EXCLUDE_FROM_ALL;SYSTEM", "", ""},
+    {"add_test", 0, "COMMAND_EXPAND_LISTS", "NAME;WORKING_DIRECTORY", "COMMAND;CONFIGURATIONS"},
+    {"cmake_minimum_required", 0, "FATAL_ERROR", "VERSION", ""},
+    {"configure_file", 2, "COPYONLY;ESCAPE_QUOTES;@ONLY;NO_SOURCE_PERMISSIONS",
+        "NEWLINE_STYLE;FILE_PERMISSIONS", ""},
+    {"execute_process", 0,
+        "OUTPUT_QUIET;ERROR_QUIET;OUTPUT_STRIP_TRAILING_WHITESPACE;"
+        "ERROR_STRIP_TRAILING_WHITESPACE;ECHO_OUTPUT_VARIABLE;ECHO_ERROR_VARIABLE",
+        "WORKING_DIRECTORY;TIMEOUT;RESULT_VARIABLE;RESULTS_VARIABLE;OUTPUT_VARIABLE;"
+        "ERROR_VARIABLE;INPUT_FILE;OUTPUT_FILE;ERROR_FILE;COMMAND_ECHO;ENCODING;"
+        "COMMAND_ERROR_IS_FATAL",
+        "COMMAND"},
+    {"find_file", 1, "REQUIRED;NO_DEFAULT_PATH;NO_CMAKE_PATH;NO_SYSTEM_ENVIRONMENT_PATH", "DOC",
+        "NAMES;HINTS;PATHS;PATH_SUFFIXES"},
+    {"find_library", 1, "REQUIRED;NO_DEFAULT_PATH;NO_CMAKE_PATH;NO_SYSTEM_ENVIRONMENT_PATH",
+        "DOC", "NAMES;HINTS;PATHS;PATH_SUFFIXES"},
+    {"find_package", 1,
+        "EXACT;QUIET;MODULE;CONFIG;NO_MODULE;REQUIRED;NO_POLICY_SCOPE;GLOBAL;NO_DEFAULT_PATH",
+        "", "COMPONENTS;OPTIONAL_COMPONENTS;NAMES;CONFIGS;HINTS;PATHS;PATH_SUFFIXES"},
+    {"find_path", 1, "REQUIRED;NO_DEFAULT_PATH;NO_CMAKE_PATH;NO_SYSTEM_ENVIRONMENT_PATH", "DOC",
+        "NAMES;HINTS;PATHS;PATH_SUFFIXES"},
+    {"find_program", 1, "REQUIRED;NO_DEFAULT_PATH;NO_CMAKE_PATH;NO_SYSTEM_ENVIRONMENT_PATH",
+        "DOC", "NAMES;HINTS;PATHS;PATH_SUFFIXES"},
+    {"include_directories", 0, "AFTER;BEFORE;SYSTEM", "", ""},
+    {"install", 0,
+        "OPTIONAL;EXCLUDE_FROM_ALL;NAMELINK_ONLY;NAMELINK_SKIP;ARCHIVE;LIBRARY;RUNTIME;OBJECTS;"
+        "FRAMEWORK;BUNDLE;PUBLIC_HEADER;PRIVATE_HEADER;RESOURCE;USE_SOURCE_PERMISSIONS;"
+        "MESSAGE_NEVER;FILES_MATCHING",
+        "DESTINATION;COMPONENT;RENAME;EXPORT;NAMESPACE;FILE;NAMELINK_COMPONENT",
+        "TARGETS;FILES;PROGRAMS;DIRECTORY;SCRIPT;CODE;PERMISSIONS;CONFIGURATIONS;INCLUDES;PATTERN;"
+        "REGEX"},
+    {"message", 0,
+        "FATAL_ERROR;SEND_ERROR;WARNING;AUTHOR_WARNING;DEPRECATION;NOTICE;STATUS;VERBOSE;DEBUG;"
+        "TRACE;CHECK_START;CHECK_PASS;CHECK_FAIL",
+        "", ""},
+    {"project", 1, "", "VERSION;DESCRIPTION;HOMEPAGE_URL", "LANGUAGES"},
+    {"set", 1, "PARENT_SCOPE;FORCE", "", "CACHE"},
+    {"set_property", 0, "GLOBAL;APPEND;APPEND_STRING", "",
+        "DIRECTORY;TARGET;SOURCE;INSTALL;TEST;CACHE;PROPERTY"},
+    {"set_source_files_properties", 0, "", "", "DIRECTORY;TARGET_DIRECTORY;PROPERTIES"},
+    {"set_target_properties", 0, "", "", "PROPERTIES"},
+    {"set_tests_properties", 0, "", "", "PROPERTIES"},
+    {"target_compile_definitions", 1, "", "", "INTERFACE;PUBLIC;PRIVATE"},
+    {"target_compile_features", 1, "", "", "INTERFACE;PUBLIC;PRIVATE"},
+    {"target_compile_options", 1, "BEFORE", "", "INTERFACE;PUBLIC;PRIVATE"},
+    {"target_include_directories", 1, "SYSTEM;AFTER;BEFORE", "", "INTERFACE;PUBLIC;PRIVATE"},
+    {"target_link_directories", 1, "BEFORE", "", "INTERFACE;PUBLIC;PRIVATE"},
+    {"target_link_libraries", 1, "", "",
+        "INTERFACE;PUBLIC;PRIVATE;LINK_PRIVATE;LINK_PUBLIC;LINK_INTERFACE_LIBRARIES"},
+    {"target_link_options", 1, "BEFORE", "", "INTERFACE;PUBLIC;PRIVATE"},
+    {"target_precompile_headers", 1, "", "REUSE_FROM", "INTERFACE;PUBLIC;PRIVATE"},
+    {"target_sources", 1, "", "", "INTERFACE;PUBLIC;PRIVATE"},
+};
+
+// FNV-1a, mixed with the id of the command a keyword is looked up for, and never 0, which marks
+// an empty slot.
+static uint64_t hash_name(const std::string &name, uint32_t command_id) {
+    uint64_t hash = 14695981039346656037ull ^ (command_id * 0x9e3779b97f4a7c15ull);
+    for (char c : name) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+// The slot in table, a power of two in size, that holds name for command_id, or the empty slot
+// where it would go.
+static size_t find_slot(const std::vector<CommandSignatures::Slot> &table, uint64_t hash,
+    const std::string &name, uint32_t command_id) {
+    const size_t mask = table.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const CommandSignatures::Slot &slot = table[i];
+        if (slot.name_hash == 0 || (slot.name_hash == hash && slot.command_id == command_id &&
+                                       slot.name == name)) {
+            return i;
+        }
+    }
+}
+
+// Puts slot into table, growing it to stay at most half full.
+static void insert_slot(
+    std::vector<CommandSignatures::Slot> &table, size_t &count, CommandSignatures::Slot slot) {
+    if ((count + 1) * 2 > table.size()) {
+        std::vector<CommandSignatures::Slot> old(std::max<size_t>(64, table.size() * 2));
+        old.swap(table);
+        count = 0;
+        for (auto &moved : old) {
+            if (moved.name_hash != 0) {
+                insert_slot(table, count, std::move(moved));
+            }
+        }
+    }
+    CommandSignatures::Slot &target =
+        table[find_slot(table, slot.name_hash, slot.name, slot.command_id)];
+    count += target.name_hash == 0;
+    target = std::move(slot);
+}
+
+CommandSignatures::CommandSignatures() {
+    for (const BuiltinSignature &builtin : builtin_signatures) {
+        add(builtin.command, builtin.positional, builtin.options, builtin.one_value_keywords,
+            builtin.multi_value_keywords);
+    }
+}
+
+const CommandSignature *CommandSignatures::find_command(const std::string &command) const {
+    if (commands.empty()) {
+        return nullptr;
+    }
+    const Slot &slot = commands[find_slot(commands, hash_name(command, 0), command, 0)];
+    return slot.name_hash == 0 ? nullptr : &slot.signature;
+}
+
+KeywordKind CommandSignatures::find_keyword(
+    const CommandSignature &command, const std::string &argument) const {
+    if (argument.empty() ||
+        !keyword_first_characters[static_cast<unsigned char>(argument.front())]) {
+        return KeywordKind::None;
+    }
+    const Slot &slot =
+        keywords[find_slot(keywords, hash_name(argument, command.id), argument, command.id)];
+    return slot.name_hash == 0 ? KeywordKind::None : slot.kind;
+}
+
+void CommandSignatures::add(const std::string &command, uint32_t positional,
+    const std::string &options, const std::string &one_value_keywords,
+    const std::string &multi_value_keywords) {
+    // Ids are never reused, so the keywords of a signature this replaces are left unreachable.
+    const CommandSignature signature{next_command_id++, positional};
+    insert_slot(commands, command_count,
+        {hash_name(command, 0), command, 0, signature, KeywordKind::None});
+    auto add_keywords = [&](const std::string &list, KeywordKind kind) {
+        for (size_t start = 0; start < list.size();) {
+            size_t end = list.find(';', start);
+            if (end == std::string::npos) {
+                end = list.size();
+            }
+            if (end > start) {
+                const std::string keyword = list.substr(start, end - start);
+                keyword_first_characters[static_cast<unsigned char>(keyword.front())] = true;
+                insert_slot(keywords, keyword_count,
+                    {hash_name(keyword, signature.id), keyword, signature.id, {}, kind});
+            }
+            start = end + 1;
+        }
+    };
+    add_keywords(options, KeywordKind::Option);
+    add_keywords(one_value_keywords, KeywordKind::OneValue);
+    add_keywords(multi_value_keywords, KeywordKind::MultiValue);
+}
+
+// More positional arguments than any command has, which is most likely a mistake.
+static const unsigned long max_positional_count = 1000;
+
+static bool parse_positional_count(const std::string &argument, uint32_t &count) {
+    // strtoul() would skip leading whitespace and take "-1" as the largest count.
+    if (argument.empty() || argument[0] < '0' || argument[0] > '9') {
+        return false;
+    }
+    char *end = nullptr;
+    const unsigned long parsed = strtoul(argument.c_str(), &end, 10);
+    if (*end != '\0' || parsed > max_positional_count) {
+        return false;
+    }
+    count = static_cast<uint32_t>(parsed);
+    return true;
+}
+
+bool CommandSignatures::load(const std::string &content, std::string &error) {
+    std::vector<Span> spans;
+    try {
+        spans = parse(content);
+    } catch (const parseexception &e) {
+        error = e.what();
+        return false;
+    }
+    std::string command;
+    std::vector<std::string> arguments;
+    for (size_t i = 0; i < spans.size(); i++) {
+        if (spans[i].type != SpanType::CommandIdentifier) {
+            continue;
+        }
+        lowercase_into(command, spans[i].data);
+        arguments.clear();
+        for_each_argument(spans, i, [&](size_t argument) {
+            const Span &span = spans[argument];
+            // The spans of quoted arguments include the quotes.
+            if (span.type == SpanType::Quoted && span.data.front() == '"') {
+                arguments.push_back(span.data.substr(1, span.data.size() - 2));
+            } else {
+                arguments.push_back(span.data);
+            }
+        });
+        uint32_t positional = 0;
+        if (arguments.size() != 4 || !parse_positional_count(arguments[0], positional)) {
+            error = "expected " + command +
+                    "(POSITIONAL_COUNT OPTIONS ONE_VALUE_KEYWORDS MULTI_VALUE_KEYWORDS), at byte " +
+                    std::to_string(spans[i].offset);
+            return false;
+        }
+        add(command, positional, arguments[1], arguments[2], arguments[3]);
+    }
+    return true;
+}
+
+const CommandSignatures &builtin_command_signatures() {
+    static const CommandSignatures signatures;
+    return signatures;
+}
+
+TEST_CASE("Looks up built-in command signatures") {
+    const CommandSignatures &signatures = builtin_command_signatures();
+    REQUIRE(signatures.find_command("ADD_LIBRARY") == nullptr);
+    const CommandSignature *add_library = signatures.find_command("add_library");
+    REQUIRE(add_library != nullptr);
+    REQUIRE(add_library->positional == 1);
+    REQUIRE(signatures.find_keyword(*add_library, "STATIC") == KeywordKind::Option);
+    REQUIRE(signatures.find_keyword(*add_library, "ALIAS") == KeywordKind::OneValue);
+    REQUIRE(signatures.find_keyword(*add_library, "PUBLIC") == KeywordKind::None);
+    const CommandSignature *target_sources = signatures.find_command("target_sources");
+    REQUIRE(target_sources != nullptr);
+    REQUIRE(signatures.find_keyword(*target_sources, "PUBLIC") == KeywordKind::MultiValue);
+    REQUIRE(signatures.find_keyword(*target_sources, "STATIC") == KeywordKind::None);
+    const CommandSignature *install = signatures.find_command("install");
+    REQUIRE(install != nullptr);
+    REQUIRE(signatures.find_keyword(*install, "FILES_MATCHING") == KeywordKind::Option);
+    REQUIRE(signatures.find_keyword(*install, "PATTERN") == KeywordKind::MultiValue);
+}
+
+TEST_CASE("Loads command signatures") {
+    CommandSignatures signatures;
+    std::string error;
+    REQUIRE(signatures.load("# Comment\nmy_add_thing(2 \"FAST\" DESTINATION SOURCES;DEPENDS)\n"
+                            "ADD_LIBRARY(0 \"\" \"\" \"\")\n",
+        error));
+    const CommandSignature *my_add_thing = signatures.find_command("my_add_thing");
+    REQUIRE(my_add_thing != nullptr);
+    REQUIRE(my_add_thing->positional == 2);
+    REQUIRE(signatures.find_keyword(*my_add_thing, "FAST") == KeywordKind::Option);
+    REQUIRE(signatures.find_keyword(*my_add_thing, "DESTINATION") == KeywordKind::OneValue);
+    REQUIRE(signatures.find_keyword(*my_add_thing, "DEPENDS") == KeywordKind::MultiValue);
+    const CommandSignature *add_library = signatures.find_command("add_library");
+    REQUIRE(add_library->positional == 0);
+    REQUIRE(signatures.find_keyword(*add_library, "STATIC") == KeywordKind::None);
+    REQUIRE(signatures.find_command("target_sources") != nullptr);
+
+    REQUIRE(!signatures.load("bad(1 2)", error));
+    REQUIRE(error.find("bad(POSITIONAL_COUNT") != std::string::npos);
+    REQUIRE(!signatures.load("bad(x \"\" \"\" \"\")", error));
+    REQUIRE(!signatures.load("bad(", error));
+    REQUIRE(!signatures.load("bad(-1 \"\" \"\" \"\")", error));
+    REQUIRE(!signatures.load("bad(\" 1\" \"\" \"\" \"\")", error));
+    REQUIRE(!signatures.load("bad(100000 \"\" \"\" \"\")", error));
+    REQUIRE(signatures.find_command("bad") == nullptr);
+}
@@ -0,0 +1,77 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// What the arguments of CMake commands are, the way cmake_parse_arguments() describes them: some
+// positional arguments, then keywords, each an option, which stands alone, or followed by one
+// value or by any number. The reflow heuristic uses them to keep values with their keywords.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class KeywordKind : uint8_t {
+    // Not a keyword of the command.
+    None,
+    Option,
+    OneValue,
+    MultiValue,
+};
+
+struct CommandSignature {
+    // Identifies the command's keywords in CommandSignatures::find_keyword().
+    uint32_t id;
+    // How many arguments come before the keywords.
+    uint32_t positional;
+};
+
+// Signatures of commands, looked up by name, and keywords, looked up by command and name, each in
+// a flat open-addressed hash table, so each lookup is O(1). Made with the built-in signatures of
+// the CMake commands whose arguments are most often reflowed; more can be loaded on top.
+struct CommandSignatures {
+    CommandSignatures();
+
+    // The signature of command, whose name has to be lowercase, or null if there's none.
+    const CommandSignature *find_command(const std::string &command) const;
+    KeywordKind find_keyword(const CommandSignature &command, const std::string &argument) const;
+
+    // Adds the signatures in content, which is written as CMake commands, one for each command
+    // whose signature it gives, with four arguments, as for cmake_parse_arguments(): how many
+    // positional arguments there are, up to 1000, then lists of the options, the keywords with
+    // one value and those with any number. For example:
+    //
+    //     my_add_thing(1 "EXCLUDE_FROM_ALL" "DESTINATION" "SOURCES;DEPENDS")
+    //
+    // A signature replaces any the command already had. Returns false, and sets error, if content
+    // can't be read that way, in which case some of it might have been added.
+    bool load(const std::string &content, std::string &error);
+
+    // Adds the signature of command, whose name has to be lowercase, with keyword lists separated
+    // by semicolons.
+    void add(const std::string &command, uint32_t positional, const std::string &options,
+        const std::string &one_value_keywords, const std::string &multi_value_keywords);
+
+    // A slot in one of the tables: a command, with its signature, or a keyword of the command
+    // with the given id, with its kind. Empty if name_hash is 0.
+    struct Slot {
+        uint64_t name_hash;
+        std::string name;
+        uint32_t command_id;
+        CommandSignature signature;
+        KeywordKind kind;
+    };
+    std::vector<Slot> commands;
+    std::vector<Slot> keywords;
+    size_t command_count = 0;
+    size_t keyword_count = 0;
+    // 0 is for looking up commands themselves.
+    uint32_t next_command_id = 1;
+    // Whether any keyword starts with each character. Most arguments that aren't keywords, like
+    // file names, start with a character no keyword does, so they don't need hashing.
+    bool keyword_first_characters[256] = {};
+};
+
+// The built-in signatures, made the first time they're asked for.
+const CommandSignatures &builtin_command_signatures();
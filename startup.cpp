@@ -0,0 +1,194 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// Measures how long cmake-format takes from exec to exit on a small file, which is what
+// format-on-save in an editor waits for, and fails if that has grown past a budget.
+//
+// Starting any process costs something no change to cmake-format can remove, and how much
+// varies a lot between machines, so the budget is for the time on top of that: each run of
+// cmake-format is paired with a run of this program, which is a C++ program too, told to exit
+// at once.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "command_line.h"
+#include "corpus.h"
+
+#ifndef _WIN32
+
+extern char **environ;
+
+// Wall time to run a program to completion, in microseconds, with its output thrown away; or
+// a negative number if it couldn't be run or failed.
+static double time_process(const std::vector<std::string> &arguments) {
+    std::vector<char *> argv;
+    for (const auto &argument : arguments) {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    int status = 0;
+    const bool ran = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0 &&
+                     waitpid(pid, &status, 0) == pid;
+    const std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (!ran || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    return elapsed.count();
+}
+
+#endif
+
+// The value below which a fraction q of the sorted samples lie.
+static double percentile(const std::vector<double> &sorted, double q) {
+    const size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+struct Latency {
+    const char *name;
+    std::vector<std::string> arguments;
+    std::vector<double> samples;
+};
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && std::string{argv[1]} == "-exit-at-once") {
+        return 0;
+    }
+
+    size_t runs = 300;
+    size_t max_p50_microseconds = 0;
+    size_t max_p99_microseconds = 0;
+    std::string input_filename;
+
+    const static std::string description =
+        "Runs CMAKE_FORMAT (the cmake-format executable) many times on a small file, and\n"
+        "reports the median and 99th percentile time from exec to exit. Budgets are for the\n"
+        "time over that of starting a C++ program that exits at once.";
+    static std::vector<SwitchOptionDescription> switch_options = {};
+    const static std::vector<ArgumentOptionDescription> argument_options = {
+        {"-input", "FILE", "Format FILE, instead of a generated 2KB file.",
+            [&](const std::string &value) { input_filename = value; }},
+        {"-max-p50", "MICROSECONDS",
+            "Fail if the median time is more than MICROSECONDS over starting a program.",
+            parse_numeric_option(max_p50_microseconds)},
+        {"-max-p99", "MICROSECONDS",
+            "Fail if the 99th percentile time is more than MICROSECONDS over starting a program.",
+            parse_numeric_option(max_p99_microseconds)},
+        {"-runs", "NUMBER", "Run each command NUMBER times.", parse_numeric_option(runs)},
+    };
+    const std::vector<std::string> filenames =
+        parse_command_line(argc, argv, description, switch_options, argument_options);
+    if (filenames.size() != 1 || runs == 0) {
+        fprintf(stderr, "usage: %s [options] CMAKE_FORMAT. Try: %s -help\n", argv[0], argv[0]);
+        return 1;
+    }
+
+#ifdef _WIN32
+    fprintf(stderr, "%s: only runs on POSIX systems\n", argv[0]);
+    return 0;
+#else
+#ifdef CMAKEFORMAT_BUILD_TESTS
+    fprintf(stderr, "%s: warning: this build includes the self-test; times from a Release build "
+                    "are the ones that matter\n",
+        argv[0]);
+#endif
+
+    const std::string empty_filename = "cmake-format-startup-empty.cmake";
+    std::ofstream{empty_filename};
+    const bool generated = input_filename.empty();
+    if (generated) {
+        input_filename = "cmake-format-startup-input.cmake";
+        CorpusOptions options;
+        options.size = 2 * 1024;
+        std::ofstream{input_filename} << generate_corpus(options);
+    }
+    std::ifstream input{input_filename, std::ios::binary | std::ios::ate};
+    if (!input) {
+        fprintf(stderr, "%s: can't read '%s'\n", argv[0], input_filename.c_str());
+        return 1;
+    }
+    const long long input_size = static_cast<long long>(input.tellg());
+    const std::string input_name = "cmake-format, " + std::to_string(input_size) + " bytes";
+
+    std::vector<Latency> latencies = {
+        {"exec only", {argv[0], "-exit-at-once"}, {}},
+        {"cmake-format, empty file", {filenames[0], empty_filename}, {}},
+        {input_name.c_str(), {filenames[0], input_filename}, {}},
+    };
+    // Interleaved, so that anything else happening on the machine affects them all alike. The
+    // first round only warms up the page cache.
+    for (size_t run = 0; run <= runs; run++) {
+        for (auto &latency : latencies) {
+            const double microseconds = time_process(latency.arguments);
+            if (microseconds < 0) {
+                fprintf(stderr, "%s: '%s %s' failed\n", argv[0], latency.arguments[0].c_str(),
+                    latency.arguments[1].c_str());
+                return 1;
+            }
+            if (run > 0) {
+                latency.samples.push_back(microseconds);
+            }
+        }
+    }
+    std::remove(empty_filename.c_str());
+    if (generated) {
+        std::remove(input_filename.c_str());
+    }
+
+    printf("%-36s %10s %10s %10s %10s\n", "", "p50(us)", "p99(us)", "+p50(us)", "+p99(us)");
+    std::vector<double> &floor = latencies[0].samples;
+    std::sort(floor.begin(), floor.end());
+    double p50_overhead = 0;
+    double p99_overhead = 0;
+    for (auto &latency : latencies) {
+        std::sort(latency.samples.begin(), latency.samples.end());
+        const double p50 = percentile(latency.samples, 0.5);
+        const double p99 = percentile(latency.samples, 0.99);
+        p50_overhead = p50 - percentile(floor, 0.5);
+        p99_overhead = p99 - percentile(floor, 0.99);
+        printf("%-36s %10.0f %10.0f %10.0f %10.0f\n", latency.name, p50, p99, p50_overhead,
+            p99_overhead);
+    }
+
+    // The last row is the one that matters.
+    bool ok = true;
+    if (max_p50_microseconds != 0 && p50_overhead > max_p50_microseconds) {
+        printf("median startup is %.0f us over starting a program; the budget is %zu us\n",
+            p50_overhead, max_p50_microseconds);
+        ok = false;
+    }
+    if (max_p99_microseconds != 0 && p99_overhead > max_p99_microseconds) {
+        printf("99th percentile startup is %.0f us over starting a program; the budget is %zu "
+               "us\n",
+            p99_overhead, max_p99_microseconds);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+#endif
+}
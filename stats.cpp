@@ -0,0 +1,242 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "helpers.h"
+#include "stats.h"
+
+const char *span_type_name(SpanType type) {
+    switch (type) {
+    case SpanType::CommandIdentifier:
+        return "CommandIdentifier";
+    case SpanType::Quoted:
+        return "Quoted";
+    case SpanType::Unquoted:
+        return "Unquoted";
+    case SpanType::Newline:
+        return "Newline";
+    case SpanType::Comment:
+        return "Comment";
+    case SpanType::Space:
+        return "Space";
+    case SpanType::Lparen:
+        return "Lparen";
+    case SpanType::Rparen:
+        return "Rparen";
+    }
+    return "";
+}
+
+// Compares without allocating, unlike lowerstring(). lower must already be lower case.
+static bool equals_ignoring_case(const std::string &value, const char *lower) {
+    size_t i = 0;
+    for (; i < value.size() && lower[i]; i++) {
+        if (std::tolower(static_cast<unsigned char>(value[i])) != lower[i]) {
+            return false;
+        }
+    }
+    return i == value.size() && !lower[i];
+}
+
+static bool opens_block(const std::string &ident) {
+    return equals_ignoring_case(ident, "if") || equals_ignoring_case(ident, "foreach") ||
+           equals_ignoring_case(ident, "while") || equals_ignoring_case(ident, "macro") ||
+           equals_ignoring_case(ident, "function");
+}
+
+static bool closes_block(const std::string &ident) {
+    return equals_ignoring_case(ident, "endif") || equals_ignoring_case(ident, "endforeach") ||
+           equals_ignoring_case(ident, "endwhile") || equals_ignoring_case(ident, "endmacro") ||
+           equals_ignoring_case(ident, "endfunction");
+}
+
+FileStats compute_stats(const std::string &input, const std::vector<Span> &spans) {
+    FileStats stats;
+    stats.bytes = input.size();
+    stats.spans = spans.size();
+
+    size_t line_start = 0;
+    for (size_t pos = input.find('\n'); pos != std::string::npos;
+         pos = input.find('\n', pos + 1)) {
+        stats.longest_line = std::max(stats.longest_line, pos - line_start);
+        line_start = pos + 1;
+    }
+    stats.longest_line = std::max(stats.longest_line, input.size() - line_start);
+
+    size_t paren_depth = 0;
+    size_t block_depth = 0;
+    size_t arguments = 0;
+    for (const auto &span : spans) {
+        stats.spans_by_type[static_cast<size_t>(span.type)]++;
+        switch (span.type) {
+        case SpanType::CommandIdentifier:
+            stats.commands++;
+            arguments = 0;
+            if (closes_block(span.data) && block_depth > 0) {
+                block_depth--;
+            } else if (opens_block(span.data)) {
+                block_depth++;
+                stats.max_block_depth = std::max(stats.max_block_depth, block_depth);
+            }
+            break;
+        case SpanType::Quoted:
+        case SpanType::Unquoted:
+            arguments++;
+            stats.max_arguments_per_command = std::max(stats.max_arguments_per_command, arguments);
+            break;
+        case SpanType::Comment:
+            stats.comment_bytes += span.data.size();
+            break;
+        case SpanType::Lparen:
+            paren_depth++;
+            stats.max_paren_depth = std::max(stats.max_paren_depth, paren_depth);
+            break;
+        case SpanType::Rparen:
+            if (paren_depth > 0) {
+                paren_depth--;
+            }
+            break;
+        case SpanType::Newline:
+        case SpanType::Space:
+            break;
+        }
+    }
+    return stats;
+}
+
+void add_stats(FileStats &total, const FileStats &file) {
+    total.bytes += file.bytes;
+    total.spans += file.spans;
+    for (size_t i = 0; i < span_type_count; i++) {
+        total.spans_by_type[i] += file.spans_by_type[i];
+    }
+    total.commands += file.commands;
+    total.max_arguments_per_command =
+        std::max(total.max_arguments_per_command, file.max_arguments_per_command);
+    total.max_paren_depth = std::max(total.max_paren_depth, file.max_paren_depth);
+    total.max_block_depth = std::max(total.max_block_depth, file.max_block_depth);
+    total.longest_line = std::max(total.longest_line, file.longest_line);
+    total.comment_bytes += file.comment_bytes;
+}
+
+void StatsReport::add(const std::string &filename, const FileStats &stats, double parse_seconds) {
+    files.push_back({filename, stats, parse_seconds});
+}
+
+static double nanoseconds_per_byte(const StatsReport::File &file) {
+    return file.stats.bytes > 0 ? file.parse_seconds * 1e9 / file.stats.bytes : 0;
+}
+
+void StatsReport::write(std::ostream &out, size_t ranked_files) const {
+    FileStats total;
+    double total_parse_seconds = 0;
+    size_t name_width = std::string{"TOTAL"}.size();
+    for (const auto &file : files) {
+        add_stats(total, file.stats);
+        total_parse_seconds += file.parse_seconds;
+        name_width = std::max(name_width, file.filename.size());
+    }
+    name_width += 2;
+
+    std::ostringstream text;
+    char numbers[256];
+    text << "file" << repeat_string(" ", name_width - 4)
+         << "     bytes     spans  commands  max args  max parens  max blocks  longest line  "
+            "comments  parse ns/byte\n";
+    auto row = [&](const std::string &name, const FileStats &stats, double parse_seconds) {
+        const double comment_percent =
+            stats.bytes > 0 ? 100.0 * stats.comment_bytes / stats.bytes : 0;
+        const double ns_per_byte = stats.bytes > 0 ? parse_seconds * 1e9 / stats.bytes : 0;
+        snprintf(numbers, sizeof(numbers), "%10zu%10zu%10zu%10zu%12zu%12zu%14zu%9.1f%%%15.1f\n",
+            stats.bytes, stats.spans, stats.commands, stats.max_arguments_per_command,
+            stats.max_paren_depth, stats.max_block_depth, stats.longest_line, comment_percent,
+            ns_per_byte);
+        text << name << repeat_string(" ", name_width - name.size()) << numbers;
+    };
+    for (const auto &file : files) {
+        row(file.filename, file.stats, file.parse_seconds);
+    }
+    row("TOTAL", total, total_parse_seconds);
+
+    text << "\nspans by type:\n";
+    for (size_t i = 0; i < span_type_count; i++) {
+        const double percent = total.spans > 0 ? 100.0 * total.spans_by_type[i] / total.spans : 0;
+        snprintf(numbers, sizeof(numbers), "  %-18s%10zu%7.1f%%\n",
+            span_type_name(static_cast<SpanType>(i)), total.spans_by_type[i], percent);
+        text << numbers;
+    }
+
+    std::vector<const File *> ranked;
+    for (const auto &file : files) {
+        ranked.push_back(&file);
+    }
+    const size_t shown = std::min(ranked_files, ranked.size());
+
+    std::stable_sort(ranked.begin(), ranked.end(),
+        [](const File *a, const File *b) { return a->stats.spans > b->stats.spans; });
+    text << "\nmost spans:\n";
+    for (size_t i = 0; i < shown; i++) {
+        snprintf(numbers, sizeof(numbers), "%4zu. %10zu  ", i + 1, ranked[i]->stats.spans);
+        text << numbers << ranked[i]->filename << "\n";
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end(), [](const File *a, const File *b) {
+        return nanoseconds_per_byte(*a) > nanoseconds_per_byte(*b);
+    });
+    text << "\nslowest to parse per byte:\n";
+    for (size_t i = 0; i < shown; i++) {
+        snprintf(
+            numbers, sizeof(numbers), "%4zu. %10.1f  ", i + 1, nanoseconds_per_byte(*ranked[i]));
+        text << numbers << ranked[i]->filename << "\n";
+    }
+    out << text.str();
+}
+
+TEST_CASE("Computes stats for a file") {
+    const std::string input = "# comment\n"
+                              "IF(A)\n"
+                              "  foreach(x a \"b\" c)\n"
+                              "    command(((x)))\n"
+                              "  endforeach()\n"
+                              "endif()\n";
+    const FileStats stats = compute_stats(input, parse(input));
+    REQUIRE(stats.bytes == input.size());
+    REQUIRE(stats.spans == parse(input).size());
+    REQUIRE(stats.commands == 5);
+    REQUIRE(stats.spans_by_type[static_cast<size_t>(SpanType::CommandIdentifier)] == 5);
+    REQUIRE(stats.spans_by_type[static_cast<size_t>(SpanType::Quoted)] == 1);
+    REQUIRE(stats.spans_by_type[static_cast<size_t>(SpanType::Comment)] == 1);
+    REQUIRE(stats.max_arguments_per_command == 4);
+    REQUIRE(stats.max_paren_depth == 3);
+    REQUIRE(stats.max_block_depth == 2);
+    REQUIRE(stats.longest_line == std::string{"  foreach(x a \"b\" c)"}.size());
+    REQUIRE(stats.comment_bytes == std::string{"# comment"}.size());
+}
+
+TEST_CASE("Ranks files in a stats report") {
+    FileStats small;
+    small.bytes = 100;
+    small.spans = 10;
+    FileStats large;
+    large.bytes = 1000;
+    large.spans = 500;
+    large.max_paren_depth = 2;
+
+    StatsReport report;
+    report.add("large.cmake", large, 1e-6);
+    report.add("small.cmake", small, 1e-6);
+    std::ostringstream out;
+    report.write(out);
+    const std::string text = out.str();
+
+    REQUIRE(text.find("TOTAL" + std::string(14, ' ') + "1100       510") != std::string::npos);
+    const size_t most_spans = text.find("most spans:\n");
+    const size_t slowest = text.find("slowest to parse per byte:\n");
+    REQUIRE(text.find("   1.        500  large.cmake\n", most_spans) < slowest);
+    REQUIRE(text.find("   1.       10.0  small.cmake\n", slowest) != std::string::npos);
+    REQUIRE(text.find("   2.        1.0  large.cmake\n", slowest) != std::string::npos);
+}
@@ -0,0 +1,53 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "parser.h"
+
+constexpr size_t span_type_count = static_cast<size_t>(SpanType::Rparen) + 1;
+
+const char *span_type_name(SpanType type);
+
+// What a parsed file looks like, for finding the inputs that stress the formatter.
+struct FileStats {
+    size_t bytes = 0;
+    size_t spans = 0;
+    std::array<size_t, span_type_count> spans_by_type{};
+    size_t commands = 0;
+    size_t max_arguments_per_command = 0;
+    size_t max_paren_depth = 0;
+    // Nesting of if(), foreach(), while(), macro() and function().
+    size_t max_block_depth = 0;
+    size_t longest_line = 0;
+    size_t comment_bytes = 0;
+};
+
+// Looks at input and its parsed spans in a single pass, without changing anything.
+FileStats compute_stats(const std::string &input, const std::vector<Span> &spans);
+
+// Sums the counts and keeps the largest of the maximums.
+void add_stats(FileStats &total, const FileStats &file);
+
+// Collects stats for many files, for -stats.
+struct StatsReport {
+    struct File {
+        std::string filename;
+        FileStats stats;
+        double parse_seconds;
+    };
+
+    void add(const std::string &filename, const FileStats &stats, double parse_seconds);
+
+    // Writes a row for each file and the total, the total spans of each type, and the files
+    // with the most spans and the slowest to parse per byte.
+    void write(std::ostream &out, size_t ranked_files = 10) const;
+
+    std::vector<File> files;
+};
@@ -0,0 +1,108 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+/* Exercises cmakeformat_c.h from C, through the shared library. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmakeformat_c.h"
+
+static int failures = 0;
+
+#define CHECK(expr)                                                                                \
+    do {                                                                                           \
+        if (!(expr)) {                                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr);               \
+            failures++;                                                                            \
+        }                                                                                          \
+    } while (0)
+
+static int buffer_equals(const cmakeformat_buffer *buffer, const char *wanted) {
+    return buffer->size == strlen(wanted) && memcmp(buffer->data, wanted, buffer->size) == 0;
+}
+
+int main(void) {
+    const char *input = "IF(A)\ncommand(ARG1 ARG2 ARG3)\n\n\nENDIF(A)\n";
+    const char *wanted = "if(A)\n  command(ARG1 ARG2\n    ARG3)\n\nendif()\n";
+    const char *invalid = "command(";
+    char small[8];
+    char large[256];
+    cmakeformat_buffer buffer;
+    cmakeformat_options *options;
+    cmakeformat_context *context;
+    int i;
+
+    options = cmakeformat_options_new();
+    CHECK(options != NULL);
+    CHECK(cmakeformat_options_set_indent_width(options, 2) == CMAKEFORMAT_OK);
+    CHECK(cmakeformat_options_set_column_limit(options, 20) == CMAKEFORMAT_OK);
+    CHECK(cmakeformat_options_set_reflow_arguments(
+              options, CMAKEFORMAT_REFLOW_ARGUMENTS_BIN_PACK) == CMAKEFORMAT_OK);
+    CHECK(cmakeformat_options_set_command_case(options, (cmakeformat_letter_case)42) ==
+          CMAKEFORMAT_ERROR_INVALID_ARGUMENT);
+    CHECK(cmakeformat_options_set_indent_width(NULL, 2) == CMAKEFORMAT_ERROR_INVALID_ARGUMENT);
+
+    context = cmakeformat_context_new(options);
+    CHECK(context != NULL);
+    /* The context has its own copy of the options. */
+    cmakeformat_options_delete(options);
+
+    /* Context-owned storage, reused across calls. */
+    for (i = 0; i < 3; i++) {
+        buffer.data = NULL;
+        CHECK(cmakeformat_format(context, input, strlen(input), &buffer) == CMAKEFORMAT_OK);
+        CHECK(buffer_equals(&buffer, wanted));
+        CHECK(strcmp(cmakeformat_context_error(context), "") == 0);
+    }
+    /* Passed back without setting data to NULL, the context's storage isn't written to. */
+    CHECK(buffer.capacity == 0);
+    CHECK(cmakeformat_format(context, input, strlen(input), &buffer) ==
+          CMAKEFORMAT_ERROR_BUFFER_TOO_SMALL);
+    CHECK(buffer.size == strlen(wanted));
+
+    /* Caller-provided storage. */
+    buffer.data = large;
+    buffer.capacity = sizeof(large);
+    CHECK(cmakeformat_format(context, input, strlen(input), &buffer) == CMAKEFORMAT_OK);
+    CHECK(buffer_equals(&buffer, wanted));
+
+    buffer.data = small;
+    buffer.capacity = sizeof(small);
+    CHECK(cmakeformat_format(context, input, strlen(input), &buffer) ==
+          CMAKEFORMAT_ERROR_BUFFER_TOO_SMALL);
+    CHECK(buffer.size == strlen(wanted));
+
+    /* Only input_size bytes are read. */
+    buffer.data = NULL;
+    CHECK(cmakeformat_format(context, "a()b()", 3, &buffer) == CMAKEFORMAT_OK);
+    CHECK(buffer_equals(&buffer, "a()"));
+
+    buffer.data = NULL;
+    CHECK(cmakeformat_format(context, "", 0, &buffer) == CMAKEFORMAT_OK);
+    CHECK(buffer.size == 0);
+
+    /* Errors are reported, and leave the context usable. */
+    buffer.data = NULL;
+    CHECK(cmakeformat_format(context, invalid, strlen(invalid), &buffer) ==
+          CMAKEFORMAT_ERROR_PARSE);
+    CHECK(strcmp(cmakeformat_context_error(context), "") != 0);
+    CHECK(cmakeformat_format(context, "a()\0", 4, &buffer) == CMAKEFORMAT_ERROR_INVALID_ARGUMENT);
+    CHECK(cmakeformat_format(context, input, strlen(input), NULL) ==
+          CMAKEFORMAT_ERROR_INVALID_ARGUMENT);
+    CHECK(cmakeformat_format(context, input, strlen(input), &buffer) == CMAKEFORMAT_OK);
+    CHECK(buffer_equals(&buffer, wanted));
+
+    cmakeformat_context_delete(context);
+    CHECK(cmakeformat_format(NULL, input, strlen(input), &buffer) ==
+          CMAKEFORMAT_ERROR_INVALID_ARGUMENT);
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#!/bin/bash
+
+# Exercises '-git-filter-process' against a real git: files are cleaned on the way into a local
+# bare repository and smudged on the way out of it.
+#
+# usage: test_git_filter.sh path/to/cmake-format
+
+set -euo pipefail
+
+CMAKE_FORMAT=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+workdir=$(mktemp -d)
+trap 'rm -rf "$workdir"' EXIT
+
+exit_code=0
+function error() {
+    exit_code=1
+    echo >&2 -e "ERROR: $@"
+}
+
+filter="$CMAKE_FORMAT -git-filter-process -indent-width=2 -command-case=lower"
+function git_with_filter() {
+    git -c user.name=test -c user.email=test@example.com \
+        -c filter.cmake-format.process="$filter" -c filter.cmake-format.required=true "$@"
+}
+
+unformatted='IF(FOO)
+        MESSAGE(hello)
+ENDIF()
+'
+formatted='if(FOO)
+  message(hello)
+endif()
+'
+
+git init -q --bare "$workdir/origin.git"
+
+git_with_filter clone -q "$workdir/origin.git" "$workdir/writer" 2>/dev/null
+cd "$workdir/writer"
+echo "*.cmake filter=cmake-format" > .gitattributes
+for i in $(seq 1 20); do
+    printf "%s" "$unformatted" > "file$i.cmake"
+done
+git_with_filter add .gitattributes ./*.cmake
+git_with_filter commit -q -m "add files"
+git_with_filter push -q origin HEAD:master 2>/dev/null
+
+if test "$(git --git-dir="$workdir/origin.git" show master:file1.cmake)" != "$(printf "%s" "$formatted")"; then
+    error "clean filter didn't format file1.cmake in the bare repository"
+fi
+
+# Sneak an unformatted blob into the repository, bypassing the filter.
+printf "%s" "$unformatted" > file1.cmake
+blob=$(git hash-object -w --no-filters file1.cmake)
+git_with_filter update-index --cacheinfo "100644,$blob,file1.cmake"
+git_with_filter commit -q -m "unformatted blob"
+git_with_filter push -q origin HEAD:master 2>/dev/null
+
+git_with_filter clone -q "$workdir/origin.git" "$workdir/reader"
+for i in $(seq 1 20); do
+    if test "$(cat "$workdir/reader/file$i.cmake")" != "$(printf "%s" "$formatted")"; then
+        error "smudge filter didn't format file$i.cmake on checkout"
+    fi
+done
+
+exit $exit_code
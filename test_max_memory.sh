@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Exercises '-max-memory', which formats big files a piece at a time: the output has to be the
+# same as formatting the whole file at once, and a file that stops parsing partway through
+# mustn't be left cut short, or leave a temporary file behind, when formatted in place.
+#
+# usage: test_max_memory.sh path/to/cmake-format path/to/cmake-format-corpus
+
+set -euo pipefail
+
+CMAKE_FORMAT=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+CMAKE_FORMAT_CORPUS=$(cd "$(dirname "$2")" && pwd)/$(basename "$2")
+workdir=$(mktemp -d)
+trap 'rm -rf "$workdir"' EXIT
+
+exit_code=0
+function error() {
+    exit_code=1
+    echo >&2 -e "ERROR: $@"
+}
+
+cd "$workdir"
+"$CMAKE_FORMAT_CORPUS" -size=4000000 > big.cmake
+"$CMAKE_FORMAT" big.cmake > whole.cmake
+cp big.cmake streamed.cmake
+"$CMAKE_FORMAT" -i -max-memory=16 streamed.cmake
+if ! cmp -s whole.cmake streamed.cmake; then
+    error "formatting in place with -max-memory gave different output"
+fi
+
+cp big.cmake broken.cmake
+printf "broken(\n" >> broken.cmake
+if "$CMAKE_FORMAT" -i -max-memory=16 broken.cmake 2> stderr.txt; then
+    error "formatting a file that doesn't parse succeeded"
+elif test $? -ne 1; then
+    error "formatting a file that doesn't parse didn't fail with exit code 1"
+fi
+if ! grep -q "broken.cmake" stderr.txt; then
+    error "formatting a file that doesn't parse didn't say which file: $(cat stderr.txt)"
+fi
+if test -e broken.cmake.cmake-format.tmp; then
+    error "formatting a file that doesn't parse left its temporary file behind"
+fi
+if ! (cat big.cmake; printf "broken(\n") | cmp -s - broken.cmake; then
+    error "formatting a file that doesn't parse changed it"
+fi
+
+exit $exit_code
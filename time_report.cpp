@@ -0,0 +1,184 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <numeric>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "helpers.h"
+#include "time_report.h"
+
+double thread_cpu_seconds() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto ticks = [](const FILETIME &t) {
+        return (static_cast<unsigned long long>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+    };
+    return (ticks(kernel) + ticks(user)) / 1e7;
+#else
+    timespec t;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t) != 0) {
+        return 0;
+    }
+    return t.tv_sec + t.tv_nsec / 1e9;
+#endif
+}
+
+void TimeReport::begin_file(const std::string &filename) {
+    files.emplace_back();
+    files.back().filename = filename;
+}
+
+TimeReport::FileTimes &TimeReport::current_file() {
+    return files.back();
+}
+
+void TimeReport::begin_phase(Phase) {
+    phase_cpu_start = thread_cpu_seconds();
+    phase_wall_start = std::chrono::steady_clock::now();
+}
+
+void TimeReport::end_phase(Phase phase) {
+    const auto wall_end = std::chrono::steady_clock::now();
+    const double cpu_end = thread_cpu_seconds();
+    const double wall = std::chrono::duration<double>(wall_end - phase_wall_start).count();
+    const double cpu = cpu_end - phase_cpu_start;
+
+    FileTimes &file = current_file();
+    Times &times = file.phases[static_cast<size_t>(phase)];
+    times.wall_seconds += wall;
+    times.cpu_seconds += cpu;
+    file.total.wall_seconds += wall;
+    file.total.cpu_seconds += cpu;
+}
+
+static std::string format_row(const std::string &name, size_t name_width, size_t bytes,
+    const TimeReport::Times &times, double total_wall_seconds) {
+    const double mb_per_second =
+        times.wall_seconds > 0 ? bytes / times.wall_seconds / (1024 * 1024) : 0;
+    const double percent =
+        total_wall_seconds > 0 ? 100 * times.wall_seconds / total_wall_seconds : 0;
+    char numbers[128];
+    snprintf(numbers, sizeof(numbers), "%12.3f %12.3f %7.1f%% %10.1f",
+        times.wall_seconds * 1000, times.cpu_seconds * 1000, percent, mb_per_second);
+    return name + repeat_string(" ", name_width - std::min(name_width, name.size())) + numbers +
+           "\n";
+}
+
+void TimeReport::write(std::ostream &out) const {
+    size_t total_bytes = 0;
+    std::array<Times, phase_count> phases;
+    Times total;
+    size_t name_width = std::string{"TOTAL"}.size();
+    for (const auto &file : files) {
+        total_bytes += file.size;
+        for (size_t i = 0; i < phase_count; i++) {
+            phases[i].wall_seconds += file.phases[i].wall_seconds;
+            phases[i].cpu_seconds += file.phases[i].cpu_seconds;
+        }
+        total.wall_seconds += file.total.wall_seconds;
+        total.cpu_seconds += file.total.cpu_seconds;
+        name_width = std::max(name_width, file.filename.size());
+    }
+    for (size_t i = 0; i < phase_count; i++) {
+        name_width = std::max(name_width, std::string{phase_name(static_cast<Phase>(i))}.size());
+    }
+    name_width += 2;
+
+    auto header = [&](const std::string &name) {
+        return name + repeat_string(" ", name_width - name.size()) +
+               "     wall(ms)      cpu(ms)   %wall       MB/s\n";
+    };
+
+    // Phases that never ran (e.g. the reflow algorithms that weren't chosen) are left out.
+    std::vector<size_t> order;
+    for (size_t i = 0; i < phase_count; i++) {
+        if (phases[i].wall_seconds > 0 || phases[i].cpu_seconds > 0) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&](size_t a, size_t b) { return phases[a].wall_seconds > phases[b].wall_seconds; });
+
+    std::ostringstream text;
+    text << "Time report for " << files.size() << " file(s), " << total_bytes << " bytes\n\n";
+    text << header("phase");
+    for (size_t i : order) {
+        text << format_row(phase_name(static_cast<Phase>(i)), name_width, total_bytes, phases[i],
+            total.wall_seconds);
+    }
+    text << format_row("TOTAL", name_width, total_bytes, total, total.wall_seconds);
+
+    std::vector<const FileTimes *> by_time;
+    for (const auto &file : files) {
+        by_time.push_back(&file);
+    }
+    std::stable_sort(by_time.begin(), by_time.end(), [](const FileTimes *a, const FileTimes *b) {
+        return a->total.wall_seconds > b->total.wall_seconds;
+    });
+    text << "\n" << header("file");
+    for (const FileTimes *file : by_time) {
+        text << format_row(
+            file->filename, name_width, file->size, file->total, total.wall_seconds);
+    }
+    out << text.str();
+}
+
+static inline TimeReport::Times make_times(double wall_seconds, double cpu_seconds) {
+    TimeReport::Times times;
+    times.wall_seconds = wall_seconds;
+    times.cpu_seconds = cpu_seconds;
+    return times;
+}
+
+TEST_CASE("Reports time by phase and by file") {
+    TimeReport report;
+    report.begin_file("a.cmake");
+    report.current_file().size = 1024 * 1024;
+    report.begin_file("b.cmake");
+    report.current_file().size = 1024 * 1024;
+    // Made-up times, so the output is predictable.
+    report.files[0].phases[static_cast<size_t>(Phase::Parse)] = make_times(0.5, 0.25);
+    report.files[0].phases[static_cast<size_t>(Phase::Write)] = make_times(0.25, 0.25);
+    report.files[0].total = make_times(0.75, 0.5);
+    report.files[1].phases[static_cast<size_t>(Phase::Parse)] = make_times(1.0, 1.0);
+    report.files[1].total = make_times(1.0, 1.0);
+
+    std::ostringstream out;
+    report.write(out);
+    REQUIRE(out.str() ==
+            "Time report for 2 file(s), 2097152 bytes\n"
+            "\n"
+            "phase                                      wall(ms)      cpu(ms)   %wall       MB/s\n"
+            "parse                                     1500.000     1250.000    85.7%        1.3\n"
+            "write                                      250.000      250.000    14.3%        8.0\n"
+            "TOTAL                                     1750.000     1500.000   100.0%        1.1\n"
+            "\n"
+            "file                                       wall(ms)      cpu(ms)   %wall       MB/s\n"
+            "b.cmake                                   1000.000     1000.000    57.1%        1.0\n"
+            "a.cmake                                    750.000      500.000    42.9%        1.3"
+            "\n");
+}
+
+TEST_CASE("Times phases") {
+    TimeReport report;
+    report.begin_file("a.cmake");
+    report.begin_phase(Phase::Parse);
+    report.end_phase(Phase::Parse);
+    report.begin_phase(Phase::Parse);
+    report.end_phase(Phase::Parse);
+    const auto &parse = report.files[0].phases[static_cast<size_t>(Phase::Parse)];
+    REQUIRE(parse.wall_seconds >= 0);
+    REQUIRE(report.files[0].total.wall_seconds == parse.wall_seconds);
+    REQUIRE(report.files[0].total.cpu_seconds == parse.cpu_seconds);
+}
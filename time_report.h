@@ -0,0 +1,47 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "cmakeformat.h"
+
+// Wall and CPU time spent in each phase of formatting each file, for -time-report.
+struct TimeReport : PhaseObserver {
+    struct Times {
+        double wall_seconds = 0;
+        double cpu_seconds = 0;
+    };
+    struct FileTimes {
+        std::string filename;
+        size_t size = 0;
+        std::array<Times, phase_count> phases;
+        Times total;
+    };
+
+    // Phases are attributed to the most recently begun file. The file size can be set after
+    // reading it, through current_file().
+    void begin_file(const std::string &filename);
+    FileTimes &current_file();
+
+    void begin_phase(Phase phase) override;
+    void end_phase(Phase phase) override;
+
+    // Writes a table of the time in each phase over all files, then one of the time for each
+    // file, both slowest first.
+    void write(std::ostream &out) const;
+
+    std::vector<FileTimes> files;
+    // When the current phase began.
+    std::chrono::steady_clock::time_point phase_wall_start;
+    double phase_cpu_start = 0;
+};
+
+// CPU time used by the calling thread.
+double thread_cpu_seconds();
@@ -0,0 +1,229 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "helpers.h"
+#include "trace.h"
+
+// Recorders are told apart by a serial number rather than their address, which may be reused.
+static std::atomic<unsigned long> next_recorder_id{1};
+
+// The calling thread's buffer in each recorder it has recorded to, most recently used last. Only
+// the first event from each thread to a recorder takes the lock, to register a new buffer, however
+// often the thread goes back and forth between recorders.
+static thread_local std::vector<std::pair<unsigned long, TraceRecorder::ThreadEvents *>>
+    current_events;
+
+TraceRecorder::TraceRecorder() : id{next_recorder_id++}, start{std::chrono::steady_clock::now()} {
+}
+
+TraceRecorder::ThreadEvents &TraceRecorder::thread_events() {
+    if (!current_events.empty() && current_events.back().first == id) {
+        return *current_events.back().second;
+    }
+    auto found = std::find_if(current_events.begin(), current_events.end(),
+        [&](const std::pair<unsigned long, ThreadEvents *> &entry) { return entry.first == id; });
+    if (found != current_events.end()) {
+        std::rotate(found, found + 1, current_events.end());
+    } else {
+        std::lock_guard<std::mutex> lock{threads_mutex};
+        threads.emplace_back(new ThreadEvents);
+        threads.back()->thread_id = threads.size();
+        current_events.emplace_back(id, threads.back().get());
+    }
+    return *current_events.back().second;
+}
+
+double TraceRecorder::now_microseconds() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+void TraceRecorder::begin_file(const std::string &filename) {
+    ThreadEvents &thread = thread_events();
+    thread.filenames.push_back(filename);
+    thread.open.push_back(
+        {nullptr, thread.filenames.size() - 1, thread.begun++, now_microseconds(), 0, 0, 0});
+}
+
+void TraceRecorder::end_file(size_t file_size, size_t span_count) {
+    ThreadEvents &thread = thread_events();
+    Event event = thread.open.back();
+    thread.open.pop_back();
+    event.end_microseconds = now_microseconds();
+    event.file_size = file_size;
+    event.span_count = span_count;
+    thread.events.push_back(event);
+}
+
+void TraceRecorder::begin_phase(Phase phase) {
+    ThreadEvents &thread = thread_events();
+    const size_t file = thread.filenames.empty() ? 0 : thread.filenames.size() - 1;
+    thread.open.push_back({phase_name(phase), file, thread.begun++, now_microseconds(), 0, 0, 0});
+}
+
+void TraceRecorder::end_phase(Phase) {
+    ThreadEvents &thread = thread_events();
+    Event event = thread.open.back();
+    thread.open.pop_back();
+    event.end_microseconds = now_microseconds();
+    thread.events.push_back(event);
+}
+
+void TraceRecorder::write(std::ostream &out) const {
+    std::ostringstream text;
+    text << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    auto separator = [&] {
+        text << (first ? "\n" : ",\n");
+        first = false;
+    };
+    char times[64];
+    for (const auto &thread : threads) {
+        separator();
+        text << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+             << thread->thread_id << ", \"args\": {\"name\": \"worker " << thread->thread_id
+             << "\"}}";
+    }
+
+    // Events were recorded as they ended, so an enclosing file comes after its phases. Viewers
+    // want enclosing slices first, which began first, and the same trace written the same way
+    // every time, so events that start together are ordered by thread, then by when they began.
+    std::vector<std::pair<const ThreadEvents *, const Event *>> sorted;
+    for (const auto &thread : threads) {
+        for (const auto &event : thread->events) {
+            sorted.emplace_back(thread.get(), &event);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(),
+        [](const std::pair<const ThreadEvents *, const Event *> &a,
+            const std::pair<const ThreadEvents *, const Event *> &b) {
+            if (a.second->start_microseconds != b.second->start_microseconds) {
+                return a.second->start_microseconds < b.second->start_microseconds;
+            }
+            if (a.first->thread_id != b.first->thread_id) {
+                return a.first->thread_id < b.first->thread_id;
+            }
+            return a.second->sequence < b.second->sequence;
+        });
+
+    for (const auto &entry : sorted) {
+        const ThreadEvents *thread = entry.first;
+        const Event *event = entry.second;
+        const std::string &filename =
+            thread->filenames.empty() ? std::string{} : thread->filenames[event->file];
+        separator();
+        text << "  {\"name\": \"";
+        write_json_escaped(text, event->phase_name ? event->phase_name : filename);
+        snprintf(times, sizeof(times), "%.3f, \"dur\": %.3f", event->start_microseconds,
+            event->end_microseconds - event->start_microseconds);
+        text << "\", \"cat\": \"" << (event->phase_name ? "phase" : "file")
+             << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->thread_id
+             << ", \"ts\": " << times << ", \"args\": {\"file\": \"";
+        write_json_escaped(text, filename);
+        text << "\"";
+        if (!event->phase_name) {
+            text << ", \"size\": " << event->file_size << ", \"spans\": " << event->span_count;
+        }
+        text << "}}";
+    }
+    text << "\n]}\n";
+    out << text.str();
+}
+
+TEST_CASE("Records a slice for each file and phase") {
+    TraceRecorder trace;
+    trace.begin_file("a \"quoted\".cmake");
+    trace.begin_phase(Phase::Parse);
+    trace.end_phase(Phase::Parse);
+    trace.begin_phase(Phase::TransformIndent);
+    trace.end_phase(Phase::TransformIndent);
+    trace.end_file(12, 34);
+
+    REQUIRE(trace.threads.size() == 1);
+    const auto &events = trace.threads[0]->events;
+    REQUIRE(events.size() == 3);
+    REQUIRE(std::string{events[0].phase_name} == "parse");
+    REQUIRE(std::string{events[1].phase_name} == "transform_indent");
+    REQUIRE(events[2].phase_name == nullptr);
+    REQUIRE(events[2].file_size == 12);
+    REQUIRE(events[2].span_count == 34);
+    REQUIRE(events[2].start_microseconds <= events[0].start_microseconds);
+    REQUIRE(events[1].end_microseconds <= events[2].end_microseconds);
+
+    std::ostringstream out;
+    trace.write(out);
+    const std::string json = out.str();
+    REQUIRE(json.find("\"name\": \"thread_name\"") != std::string::npos);
+    REQUIRE(json.find("\"name\": \"a \\\"quoted\\\".cmake\", \"cat\": \"file\"") <
+            json.find("\"name\": \"parse\", \"cat\": \"phase\""));
+    REQUIRE(json.find("\"size\": 12, \"spans\": 34") != std::string::npos);
+}
+
+TEST_CASE("Keeps each thread's events separate") {
+    TraceRecorder trace;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 100; i++) {
+                trace.begin_file("file");
+                trace.begin_phase(Phase::Parse);
+                trace.end_phase(Phase::Parse);
+                trace.end_file(0, 0);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    REQUIRE(trace.threads.size() == 4);
+    for (const auto &thread : trace.threads) {
+        REQUIRE(thread->events.size() == 200);
+    }
+}
+
+TEST_CASE("Keeps a thread's buffer in each recorder it goes back and forth between") {
+    TraceRecorder first;
+    TraceRecorder second;
+    for (int i = 0; i < 3; i++) {
+        first.begin_phase(Phase::Parse);
+        first.end_phase(Phase::Parse);
+        second.begin_phase(Phase::Parse);
+        second.end_phase(Phase::Parse);
+    }
+    REQUIRE(first.threads.size() == 1);
+    REQUIRE(first.threads[0]->events.size() == 3);
+    REQUIRE(second.threads.size() == 1);
+    REQUIRE(second.threads[0]->events.size() == 3);
+}
+
+TEST_CASE("Orders slices that start together by thread, then by when they began") {
+    TraceRecorder trace;
+    for (size_t t = 1; t <= 2; t++) {
+        trace.threads.emplace_back(new TraceRecorder::ThreadEvents);
+        trace.threads.back()->thread_id = t;
+    }
+    // Recorded as they ended: each thread's phase, then its file, all starting together.
+    trace.threads[1]->events.push_back({"parse", 0, 1, 5, 6, 0, 0});
+    trace.threads[1]->events.push_back({nullptr, 0, 0, 5, 7, 0, 0});
+    trace.threads[0]->events.push_back({"parse", 0, 1, 5, 6, 0, 0});
+    trace.threads[0]->events.push_back({nullptr, 0, 0, 5, 7, 0, 0});
+
+    std::ostringstream out;
+    trace.write(out);
+    const std::string json = out.str();
+    const size_t file_1 = json.find("\"cat\": \"file\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1");
+    const size_t phase_1 = json.find("\"cat\": \"phase\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1");
+    const size_t file_2 = json.find("\"cat\": \"file\", \"ph\": \"X\", \"pid\": 1, \"tid\": 2");
+    const size_t phase_2 = json.find("\"cat\": \"phase\", \"ph\": \"X\", \"pid\": 1, \"tid\": 2");
+    REQUIRE(file_1 < phase_1);
+    REQUIRE(phase_1 < file_2);
+    REQUIRE(file_2 < phase_2);
+    REQUIRE(phase_2 != std::string::npos);
+}
@@ -0,0 +1,60 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "cmakeformat.h"
+
+// Records what each thread was doing when, as Chrome trace events (viewable in chrome://tracing
+// or ui.perfetto.dev), for -trace. Each thread appends to its own buffer without locking; the
+// buffers are only merged by write().
+struct TraceRecorder : PhaseObserver {
+    struct Event {
+        // A phase, or the whole of a file if phase_name is null.
+        const char *phase_name;
+        // Index into the thread's filenames.
+        size_t file;
+        // How many events began on the thread before this one.
+        size_t sequence;
+        double start_microseconds;
+        double end_microseconds;
+        size_t file_size;
+        size_t span_count;
+    };
+    struct ThreadEvents {
+        size_t thread_id = 0;
+        size_t begun = 0;
+        std::vector<std::string> filenames;
+        std::vector<Event> events;
+        // Events that have begun but not ended, innermost last.
+        std::vector<Event> open;
+    };
+
+    TraceRecorder();
+
+    // Phases from this thread are attributed to the most recently begun file, until it ends.
+    void begin_file(const std::string &filename);
+    void end_file(size_t file_size, size_t span_count);
+
+    void begin_phase(Phase phase) override;
+    void end_phase(Phase phase) override;
+
+    // Writes every thread's events as a JSON trace. Other threads must have stopped recording.
+    void write(std::ostream &out) const;
+
+    ThreadEvents &thread_events();
+    double now_microseconds() const;
+
+    unsigned long id;
+    std::chrono::steady_clock::time_point start;
+    std::mutex threads_mutex;
+    std::vector<std::unique_ptr<ThreadEvents>> threads;
+};
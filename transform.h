@@ -9,9 +9,12 @@
 
 #include "helpers.h"
 #include "parser.h"
+#include "signatures.h"
 
 void transform_argument_bin_pack(std::vector<Span> &, size_t, const std::string &);
-void transform_argument_heuristic(std::vector<Span> &, size_t, const std::string &);
+void transform_argument_bin_pack_balanced(std::vector<Span> &, size_t, const std::string &);
+void transform_argument_heuristic(
+    std::vector<Span> &, size_t, const std::string &, const CommandSignatures &);
 void transform_argument_per_line(std::vector<Span> &, const std::string &);
 void transform_command_case(std::vector<Span> &, LetterCase);
 void transform_indent(std::vector<Span> &, const std::string &);
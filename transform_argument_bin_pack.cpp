@@ -3,100 +3,68 @@
    details.  */
 
 #include "helpers.h"
+#include "layout.h"
 #include "transform.h"
+#include "traversal.h"
 
 void transform_argument_bin_pack(
     std::vector<Span> &spans, size_t column_limit, const std::string &argument_indent_string) {
 
-    size_t current_index = 0;
-    while (current_index < spans.size()) {
-        if (spans[current_index].type != SpanType::CommandIdentifier) {
-            current_index++;
+    SpanRewriter rewriter{spans};
+    thread_local std::string command_indentation;
+    thread_local std::string argument_indentation;
+    thread_local Doc doc;
+    while (!rewriter.at_end()) {
+        if (rewriter.ahead().type != SpanType::CommandIdentifier) {
+            rewriter.keep();
             continue;
         }
-        const size_t identifier_index = current_index;
 
-        const std::string ident = lowerstring(spans[identifier_index].data);
-        std::string command_indentation = get_command_indentation(identifier_index, spans);
-        size_t line_width = command_indentation.size() + ident.size();
+        get_command_indentation(rewriter, command_indentation);
+        argument_indentation.assign(command_indentation).append(argument_indent_string);
+        size_t line_width = command_indentation.size() + rewriter.ahead().data.size();
 
-        current_index++;
-        if (spans[current_index].type == SpanType::Space) {
-            line_width += spans[current_index].data.size();
-            current_index++;
+        rewriter.keep();
+        if (rewriter.ahead().type == SpanType::Space) {
+            line_width += rewriter.ahead().data.size();
+            rewriter.keep();
         }
-        if (spans[current_index].type != SpanType::Lparen) {
-            throw std::runtime_error("expected lparen, got '" + spans[current_index].data + "'");
+        if (rewriter.ahead().type != SpanType::Lparen) {
+            throw std::runtime_error("expected lparen, got '" + rewriter.ahead().data + "'");
         }
-        line_width += spans[current_index].data.size();
-        current_index++;
-
+        line_width += rewriter.ahead().data.size();
+        rewriter.keep();
+
+        // Each argument goes on the line before it if it fits, after a space unless it's the
+        // first.
+        doc.clear();
+        doc.begin_nest(argument_indentation);
+        doc.begin_fill();
         bool first_argument = true;
-        while (spans[current_index].type != SpanType::Rparen) {
-            if (spans[current_index].type == SpanType::Space) {
-                delete_span(spans, current_index);
-            } else if (spans[current_index].type == SpanType::Newline) {
-                delete_span(spans, current_index);
-            } else if (spans[current_index].type == SpanType::Comment) {
-                insert_span_before(current_index, spans,
-                    {
-                        {SpanType::Newline, "\n"},
-                        {SpanType::Space, command_indentation + argument_indent_string},
-                    });
-                current_index++;
-                line_width = column_limit;
-            } else if (spans[current_index].type == SpanType::Quoted ||
-                       spans[current_index].type == SpanType::Unquoted) {
-
-                bool add_line_break = false;
-                size_t argument_spans_count = 1;
-                if (spans[current_index + 1].type == SpanType::Comment) {
-                    argument_spans_count = 2;
-                    add_line_break = true;
-                } else if (spans[current_index + 1].type == SpanType::Space &&
-                           spans[current_index + 2].type == SpanType::Comment) {
-                    argument_spans_count = 3;
-                    add_line_break = true;
-                }
-
-                size_t argument_size = 0;
-                for (size_t i = 0; i < argument_spans_count; i++) {
-                    argument_size += spans[current_index + i].data.size();
-                }
-
-                if (!first_argument) {
-                    argument_size += 1;
-                }
-                if (line_width + argument_size <= column_limit) {
-                    if (!first_argument) {
-                        insert_span_before(current_index, spans, {SpanType::Space, " "});
-                    }
-                    line_width += argument_size;
-                    first_argument = false;
+        bool ends_line = false;
+        const size_t rparen =
+            for_each_argument_spans(rewriter, [&](size_t i, const ArgumentSpans &argument) {
+                if (ends_line || argument.is_comment) {
+                    doc.hard_line();
+                } else if (first_argument) {
+                    doc.soft_line();
                 } else {
-                    insert_span_before(current_index, spans,
-                        {{SpanType::Newline, "\n"},
-                            {SpanType::Space, command_indentation + argument_indent_string}});
-                    line_width = command_indentation.size() + argument_indent_string.size() +
-                                 argument_size - 1;
+                    doc.line();
                 }
-
-                if (add_line_break) {
-                    line_width = column_limit;
-                }
-
-                current_index += argument_spans_count;
-            } else {
-                throw std::runtime_error("unexpected '" + spans[current_index].data + "'");
-            }
+                doc.text(i, argument.width, argument.count);
+                first_argument = false;
+                ends_line = argument.ends_line;
+            });
+        // The closing paren only stays on the last line if there's a column to spare after it.
+        if (ends_line) {
+            doc.hard_line();
+        } else {
+            doc.soft_line();
         }
-
-        if (line_width + 1 >= column_limit) {
-            insert_span_before(current_index, spans,
-                {{SpanType::Newline, "\n"},
-                    {SpanType::Space, command_indentation + argument_indent_string}});
-        }
-        current_index++;
+        doc.text(rparen, 2);
+        doc.end_fill();
+        doc.end_nest();
+        print_doc(doc, rewriter, line_width, column_limit);
     }
 }
 
@@ -140,6 +108,17 @@ command(ARG1# comment
         transform_argument_bin_pack, 30, "    ");
 }
 
+// Each é is two bytes, but takes one column.
+TEST_CASE("Bin packs arguments by the columns they take") {
+    REQUIRE_TRANSFORMS_TO(R"(
+command(ééé ARG2 ARG3)
+)",
+        R"(
+command(ééé ARG2 ARG3)
+)",
+        transform_argument_bin_pack, 23, "    ");
+}
+
 TEST_CASE("Puts line break between line-comment and closing paren") {
     REQUIRE_TRANSFORMS_TO(R"(
 command(
@@ -166,3 +145,17 @@ command(ARG # comment
 )",
         transform_argument_bin_pack, 30, "    ");
 }
+
+// Where the first argument doesn't fit on the command line, the second still needs a space before
+// it.
+TEST_CASE("Bin packs arguments after one that doesn't fit on the command line") {
+    REQUIRE_TRANSFORMS_TO(
+        R"(
+a_long_command_name(ARGUMENT_LONG_ONE B C)
+)",
+        R"(
+a_long_command_name(
+    ARGUMENT_LONG_ONE B C)
+)",
+        transform_argument_bin_pack, 30, "    ");
+}
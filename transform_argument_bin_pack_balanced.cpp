@@ -0,0 +1,318 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// Packs arguments onto lines like transform_argument_bin_pack, but instead of filling each line
+// before starting the next, chooses all of a command's line breaks at once to leave the lines
+// about even, in the style of Knuth and Plass's line breaking.
+
+#include <algorithm>
+
+#include "helpers.h"
+#include "transform.h"
+#include "traversal.h"
+
+// An argument, together with the comment after it if there's one, or a comment by itself.
+struct PackedItem {
+    // How many spans ahead of the rewriter it starts.
+    size_t offset;
+    size_t width;
+    size_t span_count;
+    // After a comment, the next item has to start a new line.
+    bool ends_line;
+    bool is_comment;
+};
+
+// Breaks a run of words, joined by single spaces, into lines, and sets line_starts[i] for each
+// word i > 0 that starts one. The breaks minimize the sum over the lines, the last one included,
+// of the square of the columns left free at the end. A line costs more for each column it
+// overflows than all the others could together, so lines only overflow where a word can't fit.
+//
+// The cost of a line is a convex function of the width of the words on it, so it satisfies the
+// quadrangle inequality: once a later word beats an earlier one as the start of a line ending at
+// some word, it's better for every line ending after that too. So instead of trying every start
+// for every end, candidate starts are queued, each with the first end it's best for, found by
+// binary search, which takes O(n log n) in all. The first line can be shorter or longer than the
+// rest, which would break the inequality, so starting a line at word 0 is tried separately.
+static void break_lines(const std::vector<size_t> &widths, long first_capacity, long capacity,
+    std::vector<char> &line_starts) {
+    const size_t n = widths.size();
+    thread_local std::vector<double> prefix_widths;
+    thread_local std::vector<double> costs;
+    thread_local std::vector<size_t> previous_starts;
+    // Candidate starts, each with the first end it's best for; those from head on are live.
+    thread_local std::vector<std::pair<size_t, size_t>> candidates;
+
+    prefix_widths.assign(1, 0);
+    for (size_t width : widths) {
+        prefix_widths.push_back(prefix_widths.back() + width);
+    }
+    const double largest = std::max({capacity, first_capacity, 1L});
+    const double overflow_cost = (n + 1) * largest * largest;
+    auto line_cost = [&](size_t start, size_t end, long line_capacity) {
+        const double free =
+            line_capacity - (prefix_widths[end] - prefix_widths[start] + (end - start - 1));
+        return free >= 0 ? free * free : -free * overflow_cost;
+    };
+    auto cost_through = [&](size_t start, size_t end) {
+        return costs[start] + line_cost(start, end, capacity);
+    };
+
+    costs.assign(n + 1, 0);
+    previous_starts.assign(n + 1, 0);
+    candidates.clear();
+    size_t head = 0;
+    for (size_t end = 1; end <= n; end++) {
+        costs[end] = line_cost(0, end, first_capacity);
+        while (head + 1 < candidates.size() && candidates[head + 1].second <= end) {
+            head++;
+        }
+        if (head < candidates.size() && cost_through(candidates[head].first, end) < costs[end]) {
+            costs[end] = cost_through(candidates[head].first, end);
+            previous_starts[end] = candidates[head].first;
+        }
+        if (end == n) {
+            break;
+        }
+
+        // Queue end as the start of a later line, dropping the candidates it's at least as good
+        // as from where they would take over.
+        const size_t start = end;
+        while (candidates.size() > head) {
+            const size_t from = std::max(candidates.back().second, start + 1);
+            if (cost_through(start, from) > cost_through(candidates.back().first, from)) {
+                break;
+            }
+            candidates.pop_back();
+        }
+        if (candidates.size() == head) {
+            candidates.emplace_back(start, start + 1);
+            continue;
+        }
+        size_t low = std::max(candidates.back().second, start + 1) + 1;
+        size_t high = n + 1;
+        while (low < high) {
+            const size_t middle = low + (high - low) / 2;
+            if (cost_through(start, middle) <= cost_through(candidates.back().first, middle)) {
+                high = middle;
+            } else {
+                low = middle + 1;
+            }
+        }
+        if (low <= n) {
+            candidates.emplace_back(start, low);
+        }
+    }
+
+    line_starts.assign(n, false);
+    for (size_t end = n; end > 0; end = previous_starts[end]) {
+        line_starts[previous_starts[end]] = previous_starts[end] != 0;
+    }
+}
+
+void transform_argument_bin_pack_balanced(
+    std::vector<Span> &spans, size_t column_limit, const std::string &argument_indent_string) {
+
+    SpanRewriter rewriter{spans};
+    thread_local std::string command_indentation;
+    thread_local std::string argument_indentation;
+    thread_local std::vector<PackedItem> items;
+    thread_local std::vector<size_t> widths;
+    thread_local std::vector<char> paragraph_line_starts;
+    thread_local std::vector<char> line_starts;
+    while (!rewriter.at_end()) {
+        if (rewriter.ahead().type != SpanType::CommandIdentifier) {
+            rewriter.keep();
+            continue;
+        }
+
+        get_command_indentation(rewriter, command_indentation);
+        argument_indentation.assign(command_indentation).append(argument_indent_string);
+        size_t line_width = command_indentation.size() + rewriter.ahead().data.size();
+
+        rewriter.keep();
+        if (rewriter.ahead().type == SpanType::Space) {
+            line_width += rewriter.ahead().data.size();
+            rewriter.keep();
+        }
+        if (rewriter.ahead().type != SpanType::Lparen) {
+            throw std::runtime_error("expected lparen, got '" + rewriter.ahead().data + "'");
+        }
+        line_width += rewriter.ahead().data.size();
+        rewriter.keep();
+
+        // The arguments and comments, as transform_argument_bin_pack sees them.
+        items.clear();
+        const size_t start = rewriter.position;
+        for_each_argument_spans(rewriter, [&](size_t i, const ArgumentSpans &argument) {
+            items.push_back(
+                {i, argument.width, argument.count, argument.ends_line, argument.is_comment});
+        });
+
+        // Comments split the arguments into runs that are broken into lines separately.
+        const long first_capacity = static_cast<long>(column_limit) - line_width;
+        const long capacity = static_cast<long>(column_limit) -
+                              static_cast<long>(argument_indentation.size());
+        line_starts.assign(items.size(), true);
+        for (size_t first = 0; first < items.size();) {
+            if (items[first].is_comment) {
+                first++;
+                continue;
+            }
+            size_t last = first;
+            while (last + 1 < items.size() && !items[last].ends_line &&
+                   !items[last + 1].is_comment) {
+                last++;
+            }
+            widths.clear();
+            for (size_t i = first; i <= last; i++) {
+                widths.push_back(items[i].width);
+            }
+            // The closing paren only stays on the last line if there's a column to spare after
+            // it, as in transform_argument_bin_pack.
+            if (last + 1 == items.size() && !items[last].ends_line) {
+                widths.back() += 2;
+            }
+            const bool on_command_line =
+                first == 0 && static_cast<long>(widths[0]) <= first_capacity;
+            break_lines(widths, on_command_line ? first_capacity : capacity, capacity,
+                paragraph_line_starts);
+            line_starts[first] = !on_command_line;
+            std::copy(paragraph_line_starts.begin() + 1, paragraph_line_starts.end(),
+                line_starts.begin() + first + 1);
+            first = last + 1;
+        }
+
+        // break_lines() has chosen every break, so there's nothing for print_doc() to decide,
+        // and the lines go straight in.
+        for (size_t item = 0; item < items.size(); item++) {
+            while (rewriter.position < start + items[item].offset) {
+                rewriter.drop();
+            }
+            if (line_starts[item]) {
+                rewriter.insert(SpanType::Newline, "\n");
+                rewriter.insert(SpanType::Space, argument_indentation);
+                line_width = argument_indentation.size();
+            } else if (item > 0) {
+                rewriter.insert(SpanType::Space, " ");
+                line_width += 1;
+            }
+            line_width += items[item].width;
+            rewriter.keep(items[item].span_count);
+        }
+        // The closing paren only stays on the last line if there's a column to spare after it.
+        const bool ends_line = !items.empty() && items.back().ends_line;
+        close_arguments(
+            rewriter, ends_line || line_width + 2 > column_limit, argument_indentation);
+    }
+}
+
+TEST_CASE("Bin packs arguments into even lines") {
+    REQUIRE_TRANSFORMS_TO(
+        R"(
+command(ARG1 ARG2 ARG3 ARG4 ARG5 ARG6
+    ARG7)
+
+command(
+    ARG1
+    ARG2
+    ARG3 ARG4
+    ARG5 ARG6
+    ARG7 ARG8 ARG9 ARG10)
+
+command(
+    ARG1# comment
+    # entire line comment
+    ARG2 # comment preceded by space
+    ARG3 #a
+    ARG4
+    ARG5 ARG6
+    ARG7 ARG8 ARG9 ARG10)
+
+command(ARG)
+)",
+        R"(
+command(ARG1 ARG2 ARG3
+    ARG4 ARG5 ARG6 ARG7)
+
+command(ARG1 ARG2 ARG3
+    ARG4 ARG5 ARG6 ARG7
+    ARG8 ARG9 ARG10)
+
+command(ARG1# comment
+    # entire line comment
+    ARG2 # comment preceded by space
+    ARG3 #a
+    ARG4 ARG5 ARG6 ARG7
+    ARG8 ARG9 ARG10)
+
+command(ARG)
+)",
+        transform_argument_bin_pack_balanced, 30, "    ");
+}
+
+// Where transform_argument_bin_pack would leave the closing paren on a line by itself.
+TEST_CASE("Bin packs arguments that don't fit on the command line") {
+    REQUIRE_TRANSFORMS_TO(
+        R"(
+a_command_with_a_long_name(AN_ARGUMENT_THAT_IS_TOO_LONG short)
+command(ARG1 ARG2 ARG3 ARG4 ARG5 ARGUMENT6)
+)",
+        R"(
+a_command_with_a_long_name(
+    AN_ARGUMENT_THAT_IS_TOO_LONG
+    short)
+command(ARG1 ARG2
+    ARG3 ARG4 ARG5
+    ARGUMENT6)
+)",
+        transform_argument_bin_pack_balanced, 24, "    ");
+}
+
+TEST_CASE("Breaks lines where trying every break would") {
+    // The sum of the squares of the columns left free on each line, breaking at each of
+    // line_starts.
+    auto cost = [](const std::vector<size_t> &widths, long first_capacity, long capacity,
+                    const std::vector<char> &line_starts) {
+        double total = 0;
+        long free = first_capacity + 1;
+        for (size_t i = 0; i <= widths.size(); i++) {
+            if (i == widths.size() || (i > 0 && line_starts[i])) {
+                total += free >= 0 ? double(free) * free : 1e18;
+                free = capacity + 1;
+            }
+            if (i < widths.size()) {
+                free -= widths[i] + 1;
+            }
+        }
+        return total;
+    };
+
+    // A linear congruential generator, which is all the trials need.
+    uint32_t state = 1;
+    auto random = [&]() {
+        state = state * 1103515245 + 12345;
+        return state >> 16;
+    };
+    std::vector<size_t> widths;
+    std::vector<char> line_starts;
+    for (int trial = 0; trial < 200; trial++) {
+        widths.resize(1 + random() % 12);
+        for (auto &width : widths) {
+            width = 1 + random() % 12;
+        }
+        const long first_capacity = 12 + random() % 20;
+        const long capacity = 12 + random() % 20;
+        break_lines(widths, first_capacity, capacity, line_starts);
+
+        double best = 1e18;
+        std::vector<char> candidate(widths.size());
+        for (size_t breaks = 0; breaks < (size_t(1) << (widths.size() - 1)); breaks++) {
+            for (size_t i = 1; i < widths.size(); i++) {
+                candidate[i] = (breaks >> (i - 1)) & 1;
+            }
+            best = std::min(best, cost(widths, first_capacity, capacity, candidate));
+        }
+        REQUIRE(cost(widths, first_capacity, capacity, line_starts) == best);
+    }
+}
@@ -3,200 +3,378 @@
    details.  */
 
 #include <cstdio>
-#include <functional>
-
-#include <optional.hpp>
+#include <limits>
 
 #include "helpers.h"
+#include "layout.h"
 #include "transform.h"
+#include "traversal.h"
+
+// What the heuristics need to know about an argument, found once for each.
+struct ArgumentClass {
+    bool is_command_keyword;
+    KeywordKind keyword;
+    // One of the arguments that come before the command's keywords, like add_library's name.
+    bool positional;
+};
+
+// An argument, with the comment after it if there's one, a comment by itself, or the closing
+// paren, as the layout search sees it.
+struct HeuristicItem {
+    size_t offset;
+    size_t width;
+    size_t span_count;
+    // It's a comment by itself or comes after one, so it has to start a line.
+    bool starts_line;
+    // It's the first argument or the closing paren, with no space before it on the same line.
+    bool joined;
+    // An argument in a run of lowercase ones, which would rather have a line to itself.
+    bool own_line;
+    // An argument like PUBLIC or DESTINATION, and whether values follow it, or one that isn't.
+    bool keyword;
+    bool takes_values;
+    bool value;
+};
 
-using std::experimental::optional;
-using std::experimental::nullopt;
-using namespace std::placeholders;
+// Penalties for the layout search, in the manner of clang-format's. Each line break costs
+// something: less before a keyword, and more between a keyword and its first value, so that values
+// stay with their keyword. An argument that would rather have a line to itself costs something
+// for each neighbour it shares one with, and each column past the limit costs more than any of it.
+static constexpr size_t penalty_break = 20;
+static constexpr size_t penalty_break_before_keyword = 10;
+static constexpr size_t penalty_break_after_keyword = 60;
+static constexpr size_t penalty_shared_line = 100;
+static constexpr size_t penalty_excess_character = 1000;
+// How many layouts of a command the search keeps before it gives up, and the command is laid out
+// greedily instead, which bounds the time a command with very many arguments takes.
+static constexpr size_t heuristic_state_budget = 1 << 14;
 
-using ThreeArgumentWindowFunc = std::function<void(size_t, optional<size_t>, optional<size_t>)>;
-static void inline three_argument_window(const size_t &identifier_span_index,
-    std::vector<Span> &spans, const ThreeArgumentWindowFunc &f) {
-    size_t arg3 = identifier_span_index + 1;
-    while (spans[arg3].type != SpanType::Lparen) {
-        arg3++;
+// Sets breaks[i] for each item that starts a line so that the penalties add up to the least they
+// can. The items are placed one at a time. What comes after a layout of the first i of them only
+// depends on the column it ends at, so only the cheapest layout for each (i, column) is kept, and
+// each leads to at most two for i + 1. Returns false, and sets nothing, if that would take more
+// than state_budget layouts.
+//
+// A layout that ends further left for no more cost can be followed by anything the other can, for
+// no more, so each layer only keeps those that cost less the further right they end, in order of
+// column. Placing the next item on the same line moves them all right by as much, which keeps
+// that order, and breaking before it ends them all at the same column, where only the cheapest
+// matters. So each layer is a merge of the last one, moved right, with a single broken layout,
+// and takes time linear in the size of the last.
+static bool search_breaks(const std::vector<HeuristicItem> &items, size_t column,
+    size_t indentation, size_t column_limit, size_t state_budget, std::vector<char> &breaks) {
+    struct State {
+        size_t column;
+        size_t cost;
+        size_t previous;
+        bool broke;
+    };
+    static constexpr size_t none = std::numeric_limits<size_t>::max();
+    thread_local std::vector<State> states;
+
+    auto excess = [&](size_t end) {
+        return end > column_limit ? (end - column_limit) * penalty_excess_character : 0;
+    };
+
+    // Most commands fit on one line, which costs nothing, so there's nothing to search.
+    size_t flat_end = column;
+    bool free = true;
+    for (const HeuristicItem &item : items) {
+        flat_end += (item.joined ? 0 : 1) + item.width;
+        free = free && !item.starts_line && !item.own_line;
     }
-    arg3++;
-    optional<size_t> arg1;
-    optional<size_t> arg2;
-    while (spans[arg3].type != SpanType::Rparen) {
-        if (spans[arg3].type == SpanType::Quoted || spans[arg3].type == SpanType::Unquoted) {
-            if (arg1) {
-                f(*arg1, arg2, arg3);
-            }
+    if (free && flat_end <= column_limit) {
+        breaks.assign(items.size(), false);
+        return true;
+    }
+
+    states.assign(1, {column, 0, none, false});
+    size_t layer_begin = 0;
+    for (size_t i = 0; i < items.size(); i++) {
+        const HeuristicItem &item = items[i];
+        const bool after_own_line = i > 0 && items[i - 1].own_line;
+        size_t break_cost = item.keyword ? penalty_break_before_keyword : penalty_break;
+        if (i > 0 && items[i - 1].takes_values && item.value) {
+            break_cost += penalty_break_after_keyword;
+        }
+        const size_t share_cost = item.own_line || after_own_line ? penalty_shared_line : 0;
 
-            arg1 = arg2;
-            arg2 = arg3;
+        const size_t layer_end = states.size();
+        // The layout that ends furthest right is the cheapest.
+        const size_t cheapest = layer_end - 1;
+        const size_t broken_end = indentation + item.width;
+        const State broken{
+            broken_end, states[cheapest].cost + break_cost + excess(broken_end), cheapest, true};
+
+        // Appends state to the layer if it costs less than everything to its left. Only the
+        // broken layout and one moved one can end at the same column; of the two, the cheaper is
+        // kept, or if they cost the same, the one from the earlier layout, moved before broken.
+        auto push = [&](const State &state) {
+            if (states.size() > layer_end && states.back().column == state.column) {
+                const State &other = states.back();
+                if (state.cost < other.cost ||
+                    (state.cost == other.cost &&
+                        2 * state.previous + state.broke < 2 * other.previous + other.broke)) {
+                    states.back() = state;
+                }
+            } else if (states.size() == layer_end || state.cost < states.back().cost) {
+                states.push_back(state);
+            }
+        };
+        bool broken_placed = false;
+        if (!item.starts_line) {
+            const size_t shift = (item.joined ? 0 : 1) + item.width;
+            for (size_t s = layer_begin; s < layer_end; s++) {
+                const size_t from = states[s].column;
+                const State moved{
+                    from + shift, states[s].cost + share_cost + excess(from + shift) - excess(from),
+                    s, false};
+                if (!broken_placed && broken.column <= moved.column) {
+                    push(broken);
+                    broken_placed = true;
+                }
+                push(moved);
+            }
+        }
+        if (!broken_placed) {
+            push(broken);
+        }
+        layer_begin = layer_end;
+        if (states.size() > state_budget) {
+            return false;
         }
-        arg3++;
     }
-    if (arg1) {
-        f(*arg1, arg2, nullopt);
+
+    size_t best = layer_begin;
+    for (size_t s = layer_begin; s < states.size(); s++) {
+        if (states[s].cost < states[best].cost) {
+            best = s;
+        }
     }
-    if (arg2) {
-        f(*arg2, nullopt, nullopt);
+    breaks.resize(items.size());
+    for (size_t i = items.size(); i-- > 0;) {
+        breaks[i] = states[best].broke;
+        best = states[best].previous;
     }
+    return true;
 }
 
-static bool is_not_command_option(const std::string &value) {
-    return std::any_of(value.begin(), value.end(),
-        [](char c) { return !std::isupper(c) && c != '_' && c != '-' && !std::isdigit(c); });
-}
-
-void transform_argument_heuristic(
-    std::vector<Span> &spans, size_t column_width, const std::string &argument_indent_string) {
+void transform_argument_heuristic(std::vector<Span> &spans, size_t column_width,
+    const std::string &argument_indent_string, const CommandSignatures &signatures) {
 
-    size_t current_index = 0;
-    while (current_index < spans.size()) {
-        if (spans[current_index].type != SpanType::CommandIdentifier) {
-            current_index++;
+    SpanRewriter rewriter{spans};
+    // Arguments are looked at ahead of the rewrite, so they're still in the original spans.
+    const std::vector<Span> &arguments = rewriter.input;
+    thread_local std::string ident;
+    thread_local std::string command_indentation;
+    thread_local std::string argument_indentation;
+    thread_local std::vector<char> own_line;
+    thread_local std::vector<KeywordKind> keywords;
+    thread_local std::vector<HeuristicItem> items;
+    thread_local std::vector<char> breaks;
+    thread_local Doc doc;
+    while (!rewriter.at_end()) {
+        if (rewriter.ahead().type != SpanType::CommandIdentifier) {
+            rewriter.keep();
             continue;
         }
-        const size_t identifier_index = current_index;
+        const size_t identifier_index = rewriter.position;
 
-        const std::string ident = lowerstring(spans[identifier_index].data);
-        std::string command_indentation = get_command_indentation(identifier_index, spans);
+        lowercase_into(ident, rewriter.ahead().data);
+        get_command_indentation(rewriter, command_indentation);
+        argument_indentation.assign(command_indentation).append(argument_indent_string);
         size_t line_width = command_indentation.size() + ident.size();
 
-        std::vector<size_t> widths;
+        own_line.clear();
+        keywords.clear();
         {
             bool run_of_three_lowercase = false;
             bool blacklisted_keyword = false;
-            size_t argument_ordinal = 0;
-            auto f = [&](
-                const size_t &arg1, const optional<size_t> &arg2, const optional<size_t> &arg3) {
-                if (spans[arg1].data == "COMMAND") {
+            // Without a signature, anything like PUBLIC is taken for a keyword, with values.
+            const CommandSignature *signature = signatures.find_command(ident);
+            size_t classified = 0;
+            auto classify = [&](size_t i) {
+                const Span &argument = arguments[i];
+                const bool positional = signature && classified++ < signature->positional;
+                // Variable references, generator expressions, lists and paths are values, which
+                // don't need looking up.
+                const ArgumentFlags flags = argument.flags;
+                const bool value = flags.has_variable_reference ||
+                                   flags.has_generator_expression || flags.has_semicolon ||
+                                   flags.looks_like_path;
+                KeywordKind keyword = KeywordKind::None;
+                if (argument.type != SpanType::Unquoted || positional || value) {
+                } else if (signature) {
+                    keyword = signatures.find_keyword(*signature, argument.data);
+                } else if (argument.flags.all_upper) {
+                    keyword = KeywordKind::MultiValue;
+                }
+                return ArgumentClass{argument.data == "COMMAND", keyword, positional};
+            };
+            auto f = [&](const ArgumentWindow<3, ArgumentClass> &window) {
+                if (window[0].is_command_keyword) {
                     blacklisted_keyword = true;
                 }
                 if (blacklisted_keyword) {
-                } else if (is_not_command_option(spans[arg1].data)) {
-                    if (arg2 && arg3 && is_not_command_option(spans[*arg2].data) &&
-                        is_not_command_option(spans[*arg3].data)) {
+                } else if (window[0].keyword == KeywordKind::None) {
+                    if (window.size == 3 && window[1].keyword == KeywordKind::None &&
+                        window[2].keyword == KeywordKind::None) {
                         run_of_three_lowercase = true;
                     }
                 } else {
                     run_of_three_lowercase = false;
                     blacklisted_keyword = false;
                 }
-                if ((ident == "add_executable" || ident == "add_library") &&
-                    argument_ordinal == 0) {
-                    widths.push_back(0);
-                } else if (run_of_three_lowercase) {
-                    widths.push_back(column_width);
-                } else {
-                    widths.push_back(0);
-                }
-                argument_ordinal++;
+                own_line.push_back(run_of_three_lowercase && !window[0].positional);
+                keywords.push_back(window[0].keyword);
             };
-            three_argument_window(identifier_index, spans, f);
+            for_each_argument_window<3>(arguments, identifier_index, classify, f);
         }
 
-        current_index++;
-        if (spans[current_index].type == SpanType::Space) {
-            line_width += spans[current_index].data.size();
-            current_index++;
+        rewriter.keep();
+        if (rewriter.ahead().type == SpanType::Space) {
+            line_width += rewriter.ahead().data.size();
+            rewriter.keep();
         }
-        if (spans[current_index].type != SpanType::Lparen) {
-            throw std::runtime_error("expected lparen, got '" + spans[current_index].data + "'");
+        if (rewriter.ahead().type != SpanType::Lparen) {
+            throw std::runtime_error("expected lparen, got '" + rewriter.ahead().data + "'");
         }
-        line_width += spans[current_index].data.size();
-        current_index++;
+        line_width += rewriter.ahead().data.size();
+        rewriter.keep();
 
+        items.clear();
         size_t argument_ordinal = 0;
-        while (spans[current_index].type != SpanType::Rparen) {
-            if (spans[current_index].type == SpanType::Space) {
-                delete_span(spans, current_index);
-            } else if (spans[current_index].type == SpanType::Newline) {
-                delete_span(spans, current_index);
-            } else if (spans[current_index].type == SpanType::Comment) {
-                insert_span_before(current_index, spans,
-                    {
-                        {SpanType::Newline, "\n"},
-                        {SpanType::Space, command_indentation + argument_indent_string},
-                    });
-                current_index++;
-                line_width = column_width;
-            } else if (spans[current_index].type == SpanType::Quoted ||
-                       spans[current_index].type == SpanType::Unquoted) {
-
-                bool add_line_break = false;
-                size_t argument_spans_count = 1;
-                if (spans[current_index + 1].type == SpanType::Comment) {
-                    argument_spans_count = 2;
-                    add_line_break = true;
-                } else if (spans[current_index + 1].type == SpanType::Space &&
-                           spans[current_index + 2].type == SpanType::Comment) {
-                    argument_spans_count = 3;
-                    add_line_break = true;
-                }
-
-                size_t argument_size = 0;
-                for (size_t i = 0; i < argument_spans_count; i++) {
-                    argument_size += spans[current_index + i].data.size();
-                }
-                if (argument_ordinal != 0) {
-                    argument_size += 1;
-                }
-                argument_size += widths[argument_ordinal];
-
-                if (line_width + argument_size <= column_width) {
-                    if (argument_ordinal != 0) {
-                        insert_span_before(current_index, spans, {SpanType::Space, " "});
-                    }
-                    line_width += argument_size;
-                } else {
-                    insert_span_before(current_index, spans,
-                        {{SpanType::Newline, "\n"},
-                            {SpanType::Space, command_indentation + argument_indent_string}});
-                    line_width = command_indentation.size() + argument_indent_string.size() +
-                                 argument_size - 1;
-                }
-
-                if (add_line_break) {
-                    line_width = column_width;
+        bool ends_line = false;
+        const size_t rparen =
+            for_each_argument_spans(rewriter, [&](size_t i, const ArgumentSpans &argument) {
+                if (argument.is_comment) {
+                    items.push_back(
+                        {i, argument.width, 1, true, false, false, false, false, false});
+                    ends_line = true;
+                    return;
                 }
-
-                current_index += argument_spans_count;
+                const KeywordKind keyword = keywords[argument_ordinal];
+                items.push_back({i, argument.width, argument.count, ends_line,
+                    argument_ordinal == 0, own_line[argument_ordinal] != 0,
+                    keyword != KeywordKind::None,
+                    keyword == KeywordKind::OneValue || keyword == KeywordKind::MultiValue,
+                    keyword == KeywordKind::None});
+                ends_line = argument.ends_line;
                 argument_ordinal++;
+            });
+        // The closing paren only stays on the last line if there's a column to spare after it.
+        items.push_back({rparen, 2, 1, ends_line, true, false, false, false, false});
+
+        // Where the search gives up, arguments are packed like transform_argument_bin_pack, and
+        // those that would rather have a line to themselves get one. Where it doesn't, lines it
+        // doesn't break have room for what follows, so the fill doesn't break them either.
+        const bool searched = search_breaks(items, line_width, argument_indentation.size(),
+            column_width, heuristic_state_budget, breaks);
+        doc.clear();
+        doc.begin_nest(argument_indentation);
+        doc.begin_fill();
+        for (size_t item = 0; item < items.size(); item++) {
+            const bool after_own_line = item > 0 && items[item - 1].own_line;
+            if (items[item].starts_line ||
+                (searched ? breaks[item] != 0 : items[item].own_line || after_own_line)) {
+                doc.hard_line();
+            } else if (items[item].joined) {
+                doc.soft_line();
             } else {
-                throw std::runtime_error("unexpected '" + spans[current_index].data + "'");
+                doc.line();
             }
+            doc.text(items[item].offset, items[item].width, items[item].span_count);
         }
+        doc.end_fill();
+        doc.end_nest();
+        print_doc(doc, rewriter, line_width, column_width);
+    }
+}
 
-        if (line_width + 1 >= column_width) {
-            insert_span_before(current_index, spans,
-                {{SpanType::Newline, "\n"},
-                    {SpanType::Space, command_indentation + argument_indent_string}});
-        }
+// A line that starts with an argument that didn't fit on the command line is as wide as it looks.
+TEST_CASE("Keeps arguments after one that doesn't fit on the command line within the limit") {
+    REQUIRE_TRANSFORMS_TO(
+        R"(
+a_long_command_name(ARGUMENT_LONG_ONE BBBBBBBBB)
+)",
+        R"(
+a_long_command_name(
+    ARGUMENT_LONG_ONE
+    BBBBBBBBB)
+)",
+        transform_argument_heuristic, 30, "    ", builtin_command_signatures());
+}
+
+TEST_CASE("Keeps values on the line of their keyword") {
+    REQUIRE_TRANSFORMS_TO(
+        R"(
+target_link_libraries(target PUBLIC first second PRIVATE third)
+)",
+        R"(
+target_link_libraries(target
+    PUBLIC first second PRIVATE third)
+)",
+        transform_argument_heuristic, 40, "    ", builtin_command_signatures());
+}
 
-        current_index++;
+TEST_CASE("Gives arguments in runs of lowercase ones lines of their own") {
+    REQUIRE_TRANSFORMS_TO(
+        R"(
+add_library(target a.cpp b.cpp c.cpp)
+)",
+        R"(
+add_library(target
+    a.cpp
+    b.cpp
+    c.cpp
+    )
+)",
+        transform_argument_heuristic, 80, "    ", builtin_command_signatures());
+}
+
+TEST_CASE("Groups arguments by the keywords of their command's signature") {
+    const std::string input = R"(
+my_thing(target FAST SOURCES AAA_1 BBB_2 DESTINATION lib)
+)";
+    // Without a signature, AAA_1 and BBB_2 look like keywords too.
+    REQUIRE_TRANSFORMS_TO(input, R"(
+my_thing(target FAST SOURCES AAA_1
+    BBB_2 DESTINATION lib)
+)",
+        transform_argument_heuristic, 36, "    ", builtin_command_signatures());
+    CommandSignatures signatures;
+    std::string error;
+    REQUIRE(signatures.load(R"(my_thing(1 "FAST" "DESTINATION" "SOURCES"))", error));
+    REQUIRE_TRANSFORMS_TO(input, R"(
+my_thing(target FAST
+    SOURCES AAA_1 BBB_2
+    DESTINATION lib)
+)",
+        transform_argument_heuristic, 36, "    ", signatures);
+}
+
+TEST_CASE("Gives up searching for breaks past the budget") {
+    std::vector<HeuristicItem> items;
+    for (size_t i = 0; i < 20; i++) {
+        items.push_back({i, 4, 1, false, i == 0, false, false, false, true});
     }
+    std::vector<char> breaks;
+    REQUIRE(search_breaks(items, 10, 4, 30, 1000, breaks));
+    REQUIRE(breaks.size() == items.size());
+    REQUIRE(!search_breaks(items, 10, 4, 30, 20, breaks));
 }
 
-// TEST_CASE("Puts each argument on its own line", "[argument-heuristic]") {
-//     REQUIRE_TRANSFORMS_TO(run,
-//         R"(
-//     command(ARG1 ARG2 ARG3)
-//     cmake_minimum_required(VERSION 3.0)
-//     project(cmake-format)
-// )",
-//         R"(
-//     command(
-//     INDENT ARG1
-//     INDENT ARG2
-//     INDENT ARG3
-//     )
-//     cmake_minimum_required(
-//     INDENT VERSION
-//     INDENT 3.0
-//     )
-//     project(
-//     INDENT cmake-format
-//     )
-// )");
-// }
+TEST_CASE("Slides a window over a command's arguments") {
+    const std::vector<Span> spans = parse("command(A \"b\" # comment\n  c D)");
+    std::vector<std::string> windows;
+    for_each_argument_window<3>(spans, 0, [&](size_t i) { return spans[i].data; },
+        [&](const ArgumentWindow<3, std::string> &window) {
+            std::string joined;
+            for (size_t i = 0; i < window.size; i++) {
+                joined += (i > 0 ? " " : "") + window[i];
+            }
+            windows.push_back(joined);
+        });
+    const std::vector<std::string> expected = {"A \"b\" c", "\"b\" c D", "c D", "D"};
+    REQUIRE(windows == expected);
+}
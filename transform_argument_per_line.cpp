@@ -8,36 +8,36 @@
 void transform_argument_per_line(
     std::vector<Span> &spans, const std::string &argument_indent_string) {
 
-    size_t current_index = 0;
-    while (current_index < spans.size()) {
-        if (spans[current_index].type != SpanType::CommandIdentifier) {
-            current_index++;
+    SpanRewriter rewriter{spans};
+    thread_local std::string command_indentation;
+    thread_local std::string argument_indentation;
+    while (!rewriter.at_end()) {
+        if (rewriter.ahead().type != SpanType::CommandIdentifier) {
+            rewriter.keep();
             continue;
         }
-        const size_t identifier_index = current_index;
-        std::string command_indentation = get_command_indentation(identifier_index, spans);
+        get_command_indentation(rewriter, command_indentation);
+        argument_indentation.assign(command_indentation).append(argument_indent_string);
 
-        // Walk forwards to fix argument indents.
-        current_index++;
-        while (spans[current_index].type != SpanType::Lparen) {
-            current_index++;
+        rewriter.keep();
+        while (rewriter.ahead().type != SpanType::Lparen) {
+            rewriter.keep();
         }
-        current_index++;
-        while (spans[current_index].type != SpanType::Rparen) {
-            if (spans[current_index].type == SpanType::Space) {
-                delete_span(spans, current_index);
-            } else if (spans[current_index].type == SpanType::Newline) {
-                delete_span(spans, current_index);
+        rewriter.keep();
+
+        // Each argument, and the closing paren, starts a line of its own, so there's nothing
+        // for print_doc() to decide, and the lines go straight in.
+        while (rewriter.ahead().type != SpanType::Rparen) {
+            if (rewriter.ahead().type == SpanType::Space ||
+                rewriter.ahead().type == SpanType::Newline) {
+                rewriter.drop();
             } else {
-                insert_span_before(current_index, spans,
-                    {{SpanType::Newline, "\n"},
-                        {SpanType::Space, command_indentation + argument_indent_string}});
-                current_index++;
+                rewriter.insert(SpanType::Newline, "\n");
+                rewriter.insert(SpanType::Space, argument_indentation);
+                rewriter.keep();
             }
         }
-        insert_span_before(current_index, spans,
-            {{SpanType::Newline, "\n"}, {SpanType::Space, command_indentation}});
-        current_index++;
+        close_arguments(rewriter, true, command_indentation);
     }
 }
 
@@ -13,10 +13,13 @@ void transform_command_case(std::vector<Span> &spans, LetterCase letter_case) {
             current_index++;
             continue;
         }
+        std::string &data = spans[current_index].data;
         if (letter_case == LetterCase::Lower) {
-            spans[current_index].data = lowerstring(spans[current_index].data);
+            std::transform(
+                data.begin(), data.end(), data.begin(), [](char c) { return std::tolower(c); });
         } else if (letter_case == LetterCase::Upper) {
-            spans[current_index].data = upperstring(spans[current_index].data);
+            std::transform(
+                data.begin(), data.end(), data.begin(), [](char c) { return std::toupper(c); });
         }
         current_index++;
     }
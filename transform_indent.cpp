@@ -8,6 +8,11 @@
 void transform_indent(std::vector<Span> &spans, const std::string &indent_string) {
 
     int global_indentation_level = 0;
+    // Kept from call to call, like SpanRewriterScratch, so they stop allocating once they've
+    // grown to fit.
+    thread_local std::string ident;
+    thread_local std::string old_indentation;
+    thread_local std::string indentation;
 
     size_t current_index = 0;
     while (current_index < spans.size()) {
@@ -16,7 +21,7 @@ void transform_indent(std::vector<Span> &spans, const std::string &indent_string
             continue;
         }
         const size_t identifier_index = current_index;
-        const std::string ident = lowerstring(spans[identifier_index].data);
+        lowercase_into(ident, spans[identifier_index].data);
 
         if (ident == "endif" || ident == "endforeach" || ident == "endwhile" ||
             ident == "endmacro" || ident == "endfunction") {
@@ -28,21 +33,19 @@ void transform_indent(std::vector<Span> &spans, const std::string &indent_string
             indentation_level--;
         }
 
-        const std::string old_indentation = spans[identifier_index - 1].data;
+        old_indentation.assign(spans[identifier_index - 1].data);
+        assign_repeated(indentation, indent_string, indentation_level);
 
         // Re-indent the command invocation
-        spans[identifier_index - 1].data = repeat_string(indent_string, indentation_level);
+        spans[identifier_index - 1].data.assign(indentation);
 
         // Walk forwards to fix arguments and the closing paren.
         current_index++;
         while (true) {
             if (spans[current_index].type == SpanType::Newline) {
-                size_t old_indentation_pos = spans[current_index + 1].data.find(old_indentation);
-                if (old_indentation_pos != 0) {
-                } else {
-                    spans[current_index + 1].data =
-                        (repeat_string(indent_string, indentation_level) +
-                            spans[current_index + 1].data.substr(old_indentation.size()));
+                std::string &line = spans[current_index + 1].data;
+                if (line.compare(0, old_indentation.size(), old_indentation) == 0) {
+                    line.replace(0, old_indentation.size(), indentation);
                 }
                 current_index++;
             } else if (spans[current_index].type == SpanType::Rparen) {
@@ -61,8 +64,7 @@ void transform_indent(std::vector<Span> &spans, const std::string &indent_string
                 spans[last_token_on_previous_line].type == SpanType::Comment &&
                 spans[last_token_on_previous_line - 1].type == SpanType::Space &&
                 spans[last_token_on_previous_line - 2].type == SpanType::Newline) {
-                spans[last_token_on_previous_line - 1].data =
-                    repeat_string(indent_string, indentation_level);
+                spans[last_token_on_previous_line - 1].data.assign(indentation);
                 last_token_on_previous_line -= 3;
             } else if (last_token_on_previous_line >= 1 &&
                        spans[last_token_on_previous_line].type == SpanType::Space &&
@@ -15,21 +15,20 @@ void transform_indent_rparen(std::vector<Span> &spans, const std::string &rparen
         }
 
         const size_t identifier_index = current_index;
-        const std::string ident = lowerstring(spans[identifier_index].data);
 
-        std::string command_indentation;
-        if (spans[identifier_index - 1].type == SpanType::Newline) {
-            command_indentation = "";
-        } else {
-            command_indentation = spans[identifier_index - 1].data;
-        }
+        static const std::string no_indentation;
+        const std::string &command_indentation =
+            spans[identifier_index - 1].type == SpanType::Newline
+                ? no_indentation
+                : spans[identifier_index - 1].data;
 
         // Walk forwards to fix continuation indents.
         current_index++;
         while (true) {
             if (spans[current_index].type == SpanType::Rparen) {
                 if (spans[current_index - 2].type == SpanType::Newline) {
-                    spans[current_index - 1].data = (command_indentation + rparen_indent_string);
+                    spans[current_index - 1].data.assign(command_indentation).append(
+                        rparen_indent_string);
                 }
                 break;
             } else {
@@ -6,33 +6,34 @@
 
 void transform_loosen_loop_constructs(std::vector<Span> &spans) {
 
-    size_t current_index = 0;
-    while (current_index < spans.size()) {
-        if (spans[current_index].type != SpanType::CommandIdentifier) {
-            current_index++;
+    SpanRewriter rewriter{spans};
+    thread_local std::string ident;
+    while (!rewriter.at_end()) {
+        if (rewriter.ahead().type != SpanType::CommandIdentifier) {
+            rewriter.keep();
             continue;
         }
-        const std::string ident = lowerstring(spans[current_index].data);
-        current_index++;
+        lowercase_into(ident, rewriter.ahead().data);
+        rewriter.keep();
 
         if (!(ident == "else" || ident == "endif" || ident == "endwhile" || ident == "endmacro" ||
                 ident == "endfunction" || ident == "endforeach")) {
             continue;
         }
 
-        while (spans[current_index].type != SpanType::Lparen) {
-            current_index++;
+        while (rewriter.ahead().type != SpanType::Lparen) {
+            rewriter.keep();
         }
-        current_index++;
-        while (spans[current_index].type != SpanType::Rparen) {
-            if (spans[current_index].type == SpanType::Comment) {
-                current_index += 2; // skip newline
+        rewriter.keep();
+        while (rewriter.ahead().type != SpanType::Rparen) {
+            if (rewriter.ahead().type == SpanType::Comment) {
+                rewriter.keep(2); // skip newline
                 continue;
             }
-            delete_span(spans, current_index);
+            rewriter.drop();
         }
 
-        current_index++;
+        rewriter.keep();
     }
 }
 
@@ -7,12 +7,13 @@
 void transform_space_before_parens(
     std::vector<Span> &spans, SpaceBeforeParens space_before_parens) {
 
-    size_t current_index = 0;
-    while (current_index < spans.size()) {
-        if (spans[current_index].type == SpanType::CommandIdentifier) {
+    SpanRewriter rewriter{spans};
+    thread_local std::string ident;
+    while (!rewriter.at_end()) {
+        if (rewriter.ahead().type == SpanType::CommandIdentifier) {
             // Trying something new: iterate commands just by identifier tokens.
 
-            const std::string ident = lowerstring(spans[current_index].data);
+            lowercase_into(ident, rewriter.ahead().data);
 
             bool want_space = false;
             if (space_before_parens == SpaceBeforeParens::Always) {
@@ -26,17 +27,19 @@ void transform_space_before_parens(
                 want_space = true;
             }
 
-            if (spans[current_index + 1].type == SpanType::Space) {
+            rewriter.keep();
+            if (rewriter.ahead().type == SpanType::Space) {
                 if (want_space) {
-                    spans[current_index + 1].data = " ";
+                    rewriter.ahead().data = " ";
                 } else {
-                    delete_span(spans, current_index + 1);
+                    rewriter.drop();
                 }
             } else if (want_space) {
-                insert_span_at(current_index + 1, spans, {SpanType::Space, " "});
+                rewriter.insert(SpanType::Space, " ");
             }
+            continue;
         }
-        current_index++;
+        rewriter.keep();
     }
 }
 
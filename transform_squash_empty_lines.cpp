@@ -6,25 +6,25 @@
 
 void transform_squash_empty_lines(std::vector<Span> &spans, size_t max_empty_lines) {
 
-    size_t current_index = 0;
+    SpanRewriter rewriter{spans};
     size_t preceding_newlines = 0;
-    while (current_index < spans.size()) {
-        if (current_index + 1 < spans.size() && spans[current_index].type == SpanType::Space &&
-            spans[current_index + 1].type == SpanType::Newline) {
+    while (!rewriter.at_end()) {
+        if (rewriter.remaining() > 1 && rewriter.ahead().type == SpanType::Space &&
+            rewriter.ahead(1).type == SpanType::Newline) {
             // delete trailing space
-            delete_span(spans, current_index);
+            rewriter.drop();
         }
-        if (spans[current_index].type == SpanType::Newline) {
+        if (rewriter.ahead().type == SpanType::Newline) {
             if (preceding_newlines >= max_empty_lines + 1) {
-                delete_span(spans, current_index);
+                rewriter.drop();
             } else {
-                current_index++;
+                rewriter.keep();
             }
             preceding_newlines += 1;
             continue;
         }
         preceding_newlines = 0;
-        current_index++;
+        rewriter.keep();
     }
 }
 
@@ -0,0 +1,121 @@
+/* Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+   file Copyright.txt or https://opensource.org/licenses/BSD-3-Clause for
+   details.  */
+
+// Ways of walking over a command's arguments. They take the function to call as a template
+// parameter rather than a std::function, so that each use compiles to a plain loop with the
+// function inlined into it, and nothing allocates to hold a lambda's captures.
+
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "helpers.h"
+
+// Calls f(size_t) with the index of each argument of the command whose identifier is at
+// identifier_index, and returns the index of its closing paren.
+template <typename Func>
+static inline size_t for_each_argument(
+    const std::vector<Span> &spans, size_t identifier_index, const Func &f) {
+    size_t i = identifier_index + 1;
+    while (spans[i].type != SpanType::Lparen) {
+        i++;
+    }
+    for (i++; spans[i].type != SpanType::Rparen; i++) {
+        if (spans[i].type == SpanType::Quoted || spans[i].type == SpanType::Unquoted) {
+            f(i);
+        }
+    }
+    return i;
+}
+
+// An argument and up to Size - 1 of those after it, each as classify made it. size is how many
+// there are, which is less than Size only for the last few arguments of a command.
+template <size_t Size, typename T>
+struct ArgumentWindow {
+    const T &operator[](size_t i) const {
+        return values[i];
+    }
+    T values[Size];
+    size_t size;
+};
+
+// Calls f(const ArgumentWindow<Size, T> &) for each argument of the command whose identifier is
+// at identifier_index, in order, where T is what classify(size_t) returns for an argument's
+// index. Each argument is classified once, however many windows it's in.
+template <size_t Size, typename Classify, typename Func>
+static inline void for_each_argument_window(const std::vector<Span> &spans,
+    size_t identifier_index, const Classify &classify, const Func &f) {
+    static_assert(Size > 0, "a window has at least the argument itself");
+    ArgumentWindow<Size, decltype(classify(size_t()))> window{};
+    window.size = 0;
+    for_each_argument(spans, identifier_index, [&](size_t i) {
+        if (window.size == Size) {
+            f(window);
+            for (size_t j = 1; j < Size; j++) {
+                window.values[j - 1] = window.values[j];
+            }
+            window.size--;
+        }
+        window.values[window.size++] = classify(i);
+    });
+    for (; window.size > 0; window.size--) {
+        f(window);
+        for (size_t j = 1; j < window.size; j++) {
+            window.values[j - 1] = window.values[j];
+        }
+    }
+}
+
+// An argument offset spans ahead of a rewriter, together with the comment after it on the same
+// line if there's one, which means whatever comes next has to start a new line; or a comment on a
+// line of its own.
+struct ArgumentSpans {
+    size_t count;
+    size_t width;
+    bool ends_line;
+    bool is_comment;
+};
+
+// parse() marks the arguments a comment follows, so only those need looking past, and measures
+// each argument in columns rather than bytes.
+static inline ArgumentSpans argument_spans(SpanRewriter &rewriter, size_t offset) {
+    const Span &span = rewriter.ahead(offset);
+    if (!span.flags.comment_follows) {
+        return ArgumentSpans{1, span.flags.display_width, false, false};
+    }
+    ArgumentSpans argument{2, span.flags.display_width, true, false};
+    if (rewriter.ahead(offset + 1).type == SpanType::Space) {
+        argument.count = 3;
+    }
+    for (size_t i = 1; i < argument.count; i++) {
+        argument.width += rewriter.ahead(offset + i).data.size();
+    }
+    return argument;
+}
+
+// Calls f(size_t, const ArgumentSpans &) with the offset and spans of each argument and each
+// comment on a line of its own, from the rewriter's position up to the closing paren, skipping
+// the whitespace between them. Returns the offset of the closing paren.
+template <typename Func>
+static inline size_t for_each_argument_spans(SpanRewriter &rewriter, const Func &f) {
+    size_t i = 0;
+    while (rewriter.ahead(i).type != SpanType::Rparen) {
+        const SpanType type = rewriter.ahead(i).type;
+        if (type == SpanType::Space || type == SpanType::Newline) {
+            i++;
+        } else if (type == SpanType::Comment) {
+            f(i, ArgumentSpans{1, rewriter.ahead(i).data.size(), true, true});
+            i++;
+        } else if (type == SpanType::Quoted || type == SpanType::Unquoted) {
+            const ArgumentSpans argument = argument_spans(rewriter, i);
+            f(i, argument);
+            i += argument.count;
+        } else {
+            throw std::runtime_error("unexpected '" + rewriter.ahead(i).data + "'");
+        }
+    }
+    return i;
+}